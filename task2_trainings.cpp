@@ -18,6 +18,28 @@
 #include <algorithm>
 #include <sstream>
 #include <ctime>
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <tuple>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <csignal>
+#include <condition_variable>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 // ==================== Data Structures ====================
 
@@ -54,8 +76,44 @@ struct Date {
             << std::setw(2) << month << "." << year;
         return oss.str();
     }
+    
+    // Real calendar date: month 1..12, day within that month's length
+    bool isValid() const {
+        static constexpr int DAYS_IN_MONTH[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        if (month < 1 || month > 12 || day < 1) return false;
+        bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        return day <= DAYS_IN_MONTH[month - 1] + (month == 2 && leap ? 1 : 0);
+    }
+    
+    // Days since 01.01.1970 (proleptic Gregorian calendar)
+    int toDays() const {
+        int y = year - (month <= 2 ? 1 : 0);
+        int era = (y >= 0 ? y : y - 399) / 400;
+        int yoe = y - era * 400;
+        int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + doe - 719468;
+    }
+    
+    static Date fromDays(int days) {
+        days += 719468;
+        int era = (days >= 0 ? days : days - 146096) / 146097;
+        int doe = days - era * 146097;
+        int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        int mp = (5 * doy + 2) / 153;
+        int d = doy - (153 * mp + 2) / 5 + 1;
+        int m = mp < 10 ? mp + 3 : mp - 9;
+        return {d, m, yoe + era * 400 + (m <= 2 ? 1 : 0)};
+    }
 };
 
+// 01.01.1970 was a Thursday; result uses the same 0=Sunday numbering
+inline int weekdayFromDays(int days) {
+    int w = (days + 4) % 7;
+    return w < 0 ? w + 7 : w;
+}
+
 struct Time {
     int hours;
     int minutes;
@@ -76,6 +134,22 @@ struct Training {
     std::string toString() const {
         return date.toString() + " " + time.toString() + " - " + trainerName;
     }
+    
+    bool operator==(const Training& other) const {
+        return date.day == other.date.day && date.month == other.date.month &&
+               date.year == other.date.year && time.hours == other.time.hours &&
+               time.minutes == other.time.minutes && trainerName == other.trainerName;
+    }
+    
+    // Total order used to compare results whose order is not deterministic
+    bool operator<(const Training& other) const {
+        if (date.year != other.date.year) return date.year < other.date.year;
+        if (date.month != other.date.month) return date.month < other.date.month;
+        if (date.day != other.date.day) return date.day < other.date.day;
+        if (time.hours != other.time.hours) return time.hours < other.time.hours;
+        if (time.minutes != other.time.minutes) return time.minutes < other.time.minutes;
+        return trainerName < other.trainerName;
+    }
 };
 
 // Day of week names
@@ -91,6 +165,13 @@ const char* DAY_NAMES_EN[] = {
 
 // ==================== Data Generation ====================
 
+const std::vector<std::string> TRAINER_NAMES = {
+    "Иванов И.И.", "Петров П.П.", "Сидорова А.В.", 
+    "Козлов К.К.", "Смирнова М.С.", "Волков В.В.",
+    "Морозова Е.А.", "Новиков Н.Н.", "Федорова Ф.Ф.",
+    "Алексеев А.А.", "Михайлова М.М.", "Павлов П.А."
+};
+
 std::vector<Training> generateTrainings(size_t count) {
     std::vector<Training> trainings;
     trainings.reserve(count);
@@ -102,12 +183,7 @@ std::vector<Training> generateTrainings(size_t count) {
     std::uniform_int_distribution<> hour_dist(8, 21);
     std::uniform_int_distribution<> minute_dist(0, 59);
     
-    std::vector<std::string> trainers = {
-        "Иванов И.И.", "Петров П.П.", "Сидорова А.В.", 
-        "Козлов К.К.", "Смирнова М.С.", "Волков В.В.",
-        "Морозова Е.А.", "Новиков Н.Н.", "Федорова Ф.Ф.",
-        "Алексеев А.А.", "Михайлова М.М.", "Павлов П.А."
-    };
+    const std::vector<std::string>& trainers = TRAINER_NAMES;
     std::uniform_int_distribution<> trainer_dist(0, trainers.size() - 1);
     
     for (size_t i = 0; i < count; ++i) {
@@ -140,55 +216,7 @@ std::vector<Training> findTrainingsByDaySingleThread(
 
 // ==================== Multi-threaded Processing ====================
 
-void processChunk(
-    const std::vector<Training>& trainings,
-    size_t start, size_t end,
-    int dayOfWeek,
-    std::vector<Training>& localResults)
-{
-    for (size_t i = start; i < end; ++i) {
-        if (trainings[i].date.getDayOfWeek() == dayOfWeek) {
-            localResults.push_back(trainings[i]);
-        }
-    }
-}
-
-std::vector<Training> findTrainingsByDayMultiThread(
-    const std::vector<Training>& trainings,
-    int dayOfWeek,
-    int numThreads)
-{
-    std::vector<std::thread> threads;
-    std::vector<std::vector<Training>> threadResults(numThreads);
-    
-    size_t chunkSize = trainings.size() / numThreads;
-    size_t remainder = trainings.size() % numThreads;
-    
-    size_t start = 0;
-    for (int i = 0; i < numThreads; ++i) {
-        size_t end = start + chunkSize + (i < static_cast<int>(remainder) ? 1 : 0);
-        
-        threads.emplace_back(processChunk, 
-            std::cref(trainings), start, end, dayOfWeek, 
-            std::ref(threadResults[i]));
-        
-        start = end;
-    }
-    
-    for (auto& t : threads) {
-        t.join();
-    }
-    
-    // Merge results
-    std::vector<Training> result;
-    for (const auto& tr : threadResults) {
-        result.insert(result.end(), tr.begin(), tr.end());
-    }
-    
-    return result;
-}
-
-// Alternative: Using mutex for shared results
+// Each thread filters its chunk locally, then appends under a mutex
 std::vector<Training> findTrainingsByDayMultiThreadMutex(
     const std::vector<Training>& trainings,
     int dayOfWeek,
@@ -227,123 +255,3337 @@ std::vector<Training> findTrainingsByDayMultiThreadMutex(
     return result;
 }
 
-// ==================== Benchmarking ====================
+// ==================== Order-preserving Parallel Filter ====================
 
-template<typename Func>
-double measureTime(Func func) {
-    auto start = std::chrono::high_resolution_clock::now();
-    func();
-    auto end = std::chrono::high_resolution_clock::now();
-    return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+// Chunk i covers [bounds[i], bounds[i + 1]); same split as the mutex variant above
+std::vector<size_t> chunkBounds(size_t count, int numChunks) {
+    std::vector<size_t> bounds(numChunks + 1, 0);
+    size_t chunkSize = count / numChunks;
+    size_t remainder = count % numChunks;
+    for (int i = 0; i < numChunks; ++i) {
+        bounds[i + 1] = bounds[i] + chunkSize + (i < static_cast<int>(remainder) ? 1 : 0);
+    }
+    return bounds;
 }
 
-// ==================== Main ====================
-
-int main(int argc, char* argv[]) {
+// Two passes over [0, count): every thread counts matches in its chunk, an
+// exclusive prefix sum turns the counts into output offsets, then every
+// thread writes its matches straight into the preallocated output.
+// Output keeps the source order and needs no serial merge.
+//   match(k)          - does source element k pass the filter
+//   allocate(total)   - size the output once all counts are known
+//   write(out, k)     - store source element k at output position out
+template<typename Match, typename Allocate, typename Write>
+void countThenScatter(size_t count, int numThreads, Match match, Allocate allocate, Write write) {
+    std::vector<size_t> bounds = chunkBounds(count, numThreads);
+    std::vector<size_t> offsets(numThreads + 1, 0);
+    std::vector<std::thread> threads;
     
-    // Parameters - use command line args or defaults for testing
-    size_t dataSize = 500000;
-    int numThreads = 4;
-    int targetDay = 1; // Monday
+    // Pass 1: per-chunk counts
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back([&, i]() {
+            size_t matches = 0;
+            for (size_t k = bounds[i]; k < bounds[i + 1]; ++k) {
+                if (match(k)) {
+                    ++matches;
+                }
+            }
+            offsets[i + 1] = matches;
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    threads.clear();
     
-    if (argc >= 4) {
-        dataSize = std::stoul(argv[1]);
-        numThreads = std::stoi(argv[2]);
-        targetDay = std::stoi(argv[3]);
-    } else if (argc == 1) {
-        std::cout << "\nИспользование: " << argv[0] << " <размер_данных> <кол-во_потоков> <день_недели>\n";
-        std::cout << "Используются значения по умолчанию: " << dataSize << " " << numThreads << " " << targetDay << "\n";
+    // Exclusive prefix sum
+    for (int i = 0; i < numThreads; ++i) {
+        offsets[i + 1] += offsets[i];
     }
+    allocate(offsets[numThreads]);
     
-    std::cout << "\nДни недели:\n";
-    for (int i = 0; i < 7; ++i) {
-        std::cout << "  " << i << " - " << DAY_NAMES[i] << "\n";
+    // Pass 2: scatter into disjoint slices of the output
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back([&, i]() {
+            size_t out = offsets[i];
+            for (size_t k = bounds[i]; k < bounds[i + 1]; ++k) {
+                if (match(k)) {
+                    write(out++, k);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
     }
+}
+
+template<typename T, typename Pred>
+std::vector<T> parallelFilter(const std::vector<T>& items, Pred pred, int numThreads) {
+    std::vector<T> result;
+    countThenScatter(items.size(), numThreads,
+        [&](size_t k) { return pred(items[k]); },
+        [&](size_t total) { result.resize(total); },
+        [&](size_t out, size_t k) { result[out] = items[k]; });
+    return result;
+}
+
+std::vector<Training> findTrainingsByDayScatter(
+    const std::vector<Training>& trainings,
+    int dayOfWeek,
+    int numThreads)
+{
+    return parallelFilter(trainings,
+        [dayOfWeek](const Training& t) { return t.date.getDayOfWeek() == dayOfWeek; },
+        numThreads);
+}
+
+// ==================== Columnar Storage ====================
+
+// Row index into a columnar dataset
+using RowId = uint32_t;
+
+// Read-only view over column arrays; points either into TrainingColumns or
+// straight into a memory-mapped training file
+struct TrainingColumnsView {
+    const int32_t* days = nullptr;      // days since 01.01.1970
+    const uint16_t* minutes = nullptr;  // minutes since midnight
+    const uint16_t* trainers = nullptr; // index into trainerNames
+    size_t count = 0;
+    const std::string* trainerNames = nullptr;
+    size_t trainerCount = 0;
     
-    if (targetDay < 0 || targetDay > 6) {
-        std::cerr << "Ошибка: неверный номер дня недели (должен быть 0-6)!\n";
-        return 1;
+    size_t size() const { return count; }
+    
+    int weekday(size_t i) const { return weekdayFromDays(days[i]); }
+    
+    Training toTraining(size_t i) const {
+        Training t;
+        t.date = Date::fromDays(days[i]);
+        t.time = {minutes[i] / 60, minutes[i] % 60};
+        t.trainerName = trainerNames[trainers[i]];
+        return t;
     }
+};
+
+// Owning column storage, trainer names are dictionary-encoded
+struct TrainingColumns {
+    std::vector<int32_t> days;
+    std::vector<uint16_t> minutes;
+    std::vector<uint16_t> trainers;
+    std::vector<std::string> trainerNames;
+    uint64_t version = 0;  // bumped on every mutation, keys cached results
     
-    std::cout << "\nВыбранный день: " << DAY_NAMES[targetDay] << " (" << targetDay << ")\n";
+    size_t size() const { return days.size(); }
     
-    // Generate data
-    std::cout << "\n" << std::string(60, '=') << "\n";
-    std::cout << "Генерация данных...\n";
-    auto genStart = std::chrono::high_resolution_clock::now();
-    std::vector<Training> trainings = generateTrainings(dataSize);
-    auto genEnd = std::chrono::high_resolution_clock::now();
-    auto genTime = std::chrono::duration_cast<std::chrono::milliseconds>(genEnd - genStart).count();
+    void append(int32_t day, uint16_t minute, uint16_t trainer) {
+        days.push_back(day);
+        minutes.push_back(minute);
+        trainers.push_back(trainer);
+        ++version;
+    }
     
-    std::cout << "Сгенерировано " << trainings.size() << " записей за " << genTime << " мс\n";
-    std::cout << std::string(60, '=') << "\n";
+    void resize(size_t count) {
+        days.resize(count);
+        minutes.resize(count);
+        trainers.resize(count);
+    }
     
-    // Single-threaded processing
-    std::cout << "\n>>> Однопоточная обработка...\n";
-    std::vector<Training> singleResult;
-    double singleTime = measureTime([&]() {
-        singleResult = findTrainingsByDaySingleThread(trainings, targetDay);
-    });
+    TrainingColumnsView view() const {
+        return {days.data(), minutes.data(), trainers.data(), days.size(),
+                trainerNames.data(), trainerNames.size()};
+    }
+};
+
+TrainingColumns toColumns(const std::vector<Training>& trainings) {
+    TrainingColumns columns;
+    columns.resize(trainings.size());
+    std::unordered_map<std::string, uint16_t> trainerIds;
     
-    std::cout << "Найдено записей: " << singleResult.size() << "\n";
-    std::cout << "Время выполнения: " << std::fixed << std::setprecision(2) 
-              << singleTime << " мкс (" << singleTime / 1000 << " мс)\n";
+    for (size_t i = 0; i < trainings.size(); ++i) {
+        const Training& t = trainings[i];
+        auto it = trainerIds.find(t.trainerName);
+        if (it == trainerIds.end()) {
+            if (columns.trainerNames.size() > UINT16_MAX) {
+                throw std::runtime_error("Слишком много тренеров для 16-битного словаря");
+            }
+            it = trainerIds.emplace(t.trainerName,
+                static_cast<uint16_t>(columns.trainerNames.size())).first;
+            columns.trainerNames.push_back(t.trainerName);
+        }
+        columns.days[i] = t.date.toDays();
+        columns.minutes[i] = static_cast<uint16_t>(t.time.hours * 60 + t.time.minutes);
+        columns.trainers[i] = it->second;
+    }
     
-    // Multi-threaded processing (local results)
-    std::cout << "\n>>> Многопоточная обработка (локальные результаты)...\n";
-    std::cout << "Количество потоков: " << numThreads << "\n";
-    std::vector<Training> multiResult;
-    double multiTime = measureTime([&]() {
-        multiResult = findTrainingsByDayMultiThread(trainings, targetDay, numThreads);
+    return columns;
+}
+
+std::vector<Training> materialize(const TrainingColumnsView& view, const std::vector<RowId>& rows) {
+    std::vector<Training> result(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        result[i] = view.toTraining(rows[i]);
+    }
+    return result;
+}
+
+// ==================== Parallel Data Generation ====================
+//
+// Every record is derived from a SplitMix64 hash of (seed, record index)
+// alone, so any chunking of the index range produces the same bits: output
+// is identical for every thread count and each thread writes its slice of
+// preallocated storage directly.
+
+inline uint64_t splitMix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Draws a value in [0, range) from the high bits of the 96-bit product
+// entropy * range and keeps the low 64 bits as the remaining entropy for
+// the next draw. The product is assembled from 32-bit halves, which cannot
+// overflow: hi + (lo >> 32) < 2^64
+inline int drawBounded(uint64_t& entropy, uint32_t range) {
+    uint64_t lo = (entropy & 0xFFFFFFFFULL) * range;
+    uint64_t hi = (entropy >> 32) * range;
+    uint64_t mid = hi + (lo >> 32);
+    entropy = (mid << 32) | (lo & 0xFFFFFFFFULL);
+    return static_cast<int>(mid >> 32);
+}
+
+struct GeneratedRecord {
+    Date date;
+    Time time;
+    int trainer;
+};
+
+// Same value ranges as generateTrainings()
+inline GeneratedRecord generateRecord(uint64_t seed, uint64_t index) {
+    uint64_t entropy = splitMix64(seed ^ splitMix64(index));
+    GeneratedRecord r;
+    r.date.day = 1 + drawBounded(entropy, 28);
+    r.date.month = 1 + drawBounded(entropy, 12);
+    r.date.year = 2023 + drawBounded(entropy, 3);
+    r.time.hours = 8 + drawBounded(entropy, 14);
+    r.time.minutes = drawBounded(entropy, 60);
+    r.trainer = drawBounded(entropy, static_cast<uint32_t>(TRAINER_NAMES.size()));
+    return r;
+}
+
+// Runs body(begin, end) on numThreads disjoint slices of [0, count)
+template<typename Body>
+void parallelFor(size_t count, int numThreads, Body body) {
+    std::vector<size_t> bounds = chunkBounds(count, numThreads);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back([&, i]() { body(bounds[i], bounds[i + 1]); });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+std::vector<Training> generateTrainingsParallel(size_t count, int numThreads, uint64_t seed = 42) {
+    std::vector<Training> trainings(count);
+    parallelFor(count, numThreads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            GeneratedRecord r = generateRecord(seed, i);
+            trainings[i].date = r.date;
+            trainings[i].time = r.time;
+            trainings[i].trainerName = TRAINER_NAMES[r.trainer];
+        }
+    });
+    return trainings;
+}
+
+// Columnar output skips the per-record strings entirely
+TrainingColumns generateTrainingColumns(size_t count, int numThreads, uint64_t seed = 42) {
+    TrainingColumns columns;
+    columns.resize(count);
+    columns.trainerNames = TRAINER_NAMES;
+    parallelFor(count, numThreads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            GeneratedRecord r = generateRecord(seed, i);
+            columns.days[i] = r.date.toDays();
+            columns.minutes[i] = static_cast<uint16_t>(r.time.hours * 60 + r.time.minutes);
+            columns.trainers[i] = static_cast<uint16_t>(r.trainer);
+        }
     });
+    return columns;
+}
+
+// ==================== Zone Maps ====================
+
+// Summary of one block of a date-sorted layout; a predicate uses it to
+// prove that no row in the block can match
+struct ZoneMap {
+    int32_t minDays = 0;
+    int32_t maxDays = 0;
+    uint16_t minMinutes = 0;
+    uint16_t maxMinutes = 0;
+    uint8_t weekdayMask = 0;   // bit d set if the block has a row on weekday d
+    uint64_t trainerBits = 0;  // bit (id % 64) per trainer; exact up to 64 trainers
+};
+
+inline uint64_t trainerBit(size_t trainerId) {
+    return uint64_t(1) << (trainerId & 63);
+}
+
+// ==================== Query Engine ====================
+//
+// Predicates are small value types evaluated on a row of a columnar view;
+// mayMatch() answers the same question conservatively for a whole block.
+// They compose with &&, || and ! into expression templates, so every query
+// shape is its own type and the compiler inlines the whole tree into the
+// scan loop instead of dispatching through virtual calls.
+
+struct PredicateBase {};
+
+template<typename P>
+concept TrainingPredicate = std::derived_from<P, PredicateBase> &&
+    requires(const P& p, const TrainingColumnsView& v, size_t i, const ZoneMap& z) {
+        { p(v, i) } -> std::convertible_to<bool>;
+        { p.mayMatch(z) } -> std::convertible_to<bool>;
+    };
+
+struct WeekdayIs : PredicateBase {
+    int day;
+    explicit WeekdayIs(int d) : day(d) {}
+    bool operator()(const TrainingColumnsView& v, size_t i) const { return v.weekday(i) == day; }
+    bool mayMatch(const ZoneMap& z) const { return (z.weekdayMask >> day) & 1; }
+};
+
+// Inclusive range of calendar dates
+struct DateRange : PredicateBase {
+    int32_t fromDays;
+    int32_t toDays;
+    DateRange(const Date& from, const Date& to) : fromDays(from.toDays()), toDays(to.toDays()) {}
+    bool operator()(const TrainingColumnsView& v, size_t i) const {
+        return v.days[i] >= fromDays && v.days[i] <= toDays;
+    }
+    bool mayMatch(const ZoneMap& z) const { return z.maxDays >= fromDays && z.minDays <= toDays; }
+};
+
+// Inclusive range of start times within a day
+struct TimeRange : PredicateBase {
+    uint16_t fromMinutes;
+    uint16_t toMinutes;
+    TimeRange(const Time& from, const Time& to)
+        : fromMinutes(static_cast<uint16_t>(from.hours * 60 + from.minutes)),
+          toMinutes(static_cast<uint16_t>(to.hours * 60 + to.minutes)) {}
+    bool operator()(const TrainingColumnsView& v, size_t i) const {
+        return v.minutes[i] >= fromMinutes && v.minutes[i] <= toMinutes;
+    }
+    bool mayMatch(const ZoneMap& z) const { return z.maxMinutes >= fromMinutes && z.minMinutes <= toMinutes; }
+};
+
+// Bitset over dictionary ids of one dataset
+struct TrainerSet : PredicateBase {
+    std::vector<uint64_t> bits;
+    uint64_t zoneBits = 0;  // the same set folded to ZoneMap::trainerBits
     
-    std::cout << "Найдено записей: " << multiResult.size() << "\n";
-    std::cout << "Время выполнения: " << std::fixed << std::setprecision(2) 
-              << multiTime << " мкс (" << multiTime / 1000 << " мс)\n";
+    TrainerSet(const TrainingColumnsView& v, const std::vector<std::string>& names)
+        : bits((v.trainerCount + 63) / 64, 0)
+    {
+        for (size_t id = 0; id < v.trainerCount; ++id) {
+            if (std::find(names.begin(), names.end(), v.trainerNames[id]) != names.end()) {
+                bits[id >> 6] |= uint64_t(1) << (id & 63);
+                zoneBits |= trainerBit(id);
+            }
+        }
+    }
     
-    // Multi-threaded processing (mutex)
-    std::cout << "\n>>> Многопоточная обработка (с mutex)...\n";
-    std::vector<Training> multiMutexResult;
-    double multiMutexTime = measureTime([&]() {
-        multiMutexResult = findTrainingsByDayMultiThreadMutex(trainings, targetDay, numThreads);
-    });
+    bool contains(size_t id) const { return (bits[id >> 6] >> (id & 63)) & 1; }
+    bool operator()(const TrainingColumnsView& v, size_t i) const { return contains(v.trainers[i]); }
+    bool mayMatch(const ZoneMap& z) const { return (z.trainerBits & zoneBits) != 0; }
+};
+
+template<TrainingPredicate L, TrainingPredicate R>
+struct AndPredicate : PredicateBase {
+    L left;
+    R right;
+    AndPredicate(L l, R r) : left(std::move(l)), right(std::move(r)) {}
+    bool operator()(const TrainingColumnsView& v, size_t i) const { return left(v, i) && right(v, i); }
+    bool mayMatch(const ZoneMap& z) const { return left.mayMatch(z) && right.mayMatch(z); }
+};
+
+template<TrainingPredicate L, TrainingPredicate R>
+struct OrPredicate : PredicateBase {
+    L left;
+    R right;
+    OrPredicate(L l, R r) : left(std::move(l)), right(std::move(r)) {}
+    bool operator()(const TrainingColumnsView& v, size_t i) const { return left(v, i) || right(v, i); }
+    bool mayMatch(const ZoneMap& z) const { return left.mayMatch(z) || right.mayMatch(z); }
+};
+
+template<TrainingPredicate P>
+struct NotPredicate : PredicateBase {
+    P inner;
+    explicit NotPredicate(P p) : inner(std::move(p)) {}
+    bool operator()(const TrainingColumnsView& v, size_t i) const { return !inner(v, i); }
+    // A block summary cannot prove that every row matches the inner predicate
+    bool mayMatch(const ZoneMap&) const { return true; }
+};
+
+template<TrainingPredicate L, TrainingPredicate R>
+AndPredicate<L, R> operator&&(L l, R r) { return {std::move(l), std::move(r)}; }
+
+template<TrainingPredicate L, TrainingPredicate R>
+OrPredicate<L, R> operator||(L l, R r) { return {std::move(l), std::move(r)}; }
+
+template<TrainingPredicate P>
+NotPredicate<P> operator!(P p) { return NotPredicate<P>(std::move(p)); }
+
+// Runtime query built from user input: a conjunction of a weekday set,
+// date range, time range and trainer set. Shapes are not known at compile
+// time, but the type is still a single inlined predicate.
+struct QuerySpec : PredicateBase {
+    uint8_t weekdayMask = 0x7F;
+    int32_t fromDays = INT32_MIN;
+    int32_t toDays = INT32_MAX;
+    uint16_t fromMinutes = 0;
+    uint16_t toMinutes = 24 * 60 - 1;
+    std::vector<uint16_t> trainerIds;  // empty = any trainer
     
-    std::cout << "Найдено записей: " << multiMutexResult.size() << "\n";
-    std::cout << "Время выполнения: " << std::fixed << std::setprecision(2) 
-              << multiMutexTime << " мкс (" << multiMutexTime / 1000 << " мс)\n";
+    bool operator()(const TrainingColumnsView& v, size_t i) const {
+        return ((weekdayMask >> v.weekday(i)) & 1) &&
+               v.days[i] >= fromDays && v.days[i] <= toDays &&
+               v.minutes[i] >= fromMinutes && v.minutes[i] <= toMinutes &&
+               (trainerIds.empty() || matchesTrainer(v.trainers[i]));
+    }
     
-    // Results comparison
-    std::cout << "\n" << std::string(60, '=') << "\n";
-    std::cout << "                    РЕЗУЛЬТАТЫ СРАВНЕНИЯ\n";
-    std::cout << std::string(60, '=') << "\n";
+    bool mayMatch(const ZoneMap& z) const {
+        return (z.weekdayMask & weekdayMask) != 0 &&
+               z.maxDays >= fromDays && z.minDays <= toDays &&
+               z.maxMinutes >= fromMinutes && z.minMinutes <= toMinutes &&
+               (trainerIds.empty() || mayMatchTrainers(z.trainerBits));
+    }
     
-    std::cout << "\nПараметры теста:\n";
-    std::cout << "  - Размер данных: " << dataSize << " записей\n";
-    std::cout << "  - Количество потоков: " << numThreads << "\n";
-    std::cout << "  - Искомый день недели: " << DAY_NAMES[targetDay] << "\n";
+    // Without normalize() the bitsets are empty and trainerIds would be
+    // silently ignored. Entry points call this before any worker runs
+    void requireNormalized() const {
+        if (!trainerIds.empty() && trainerBits.empty()) {
+            throw std::logic_error("QuerySpec: trainerIds заданы без вызова normalize()");
+        }
+    }
     
-    std::cout << "\n┌────────────────────────────────┬──────────────┬────────────┐\n";
-    std::cout << "│ Метод                          │  Время (мс)  │ Ускорение  │\n";
-    std::cout << "├────────────────────────────────┼──────────────┼────────────┤\n";
-    std::cout << "│ Однопоточный                   │ " << std::setw(12) << std::fixed 
-              << std::setprecision(3) << singleTime / 1000 << " │     1.00x  │\n";
-    std::cout << "│ Многопоточный (локальные)      │ " << std::setw(12) << std::fixed 
-              << std::setprecision(3) << multiTime / 1000 << " │ " << std::setw(8) 
-              << std::setprecision(2) << singleTime / multiTime << "x  │\n";
-    std::cout << "│ Многопоточный (с mutex)        │ " << std::setw(12) << std::fixed 
-              << std::setprecision(3) << multiMutexTime / 1000 << " │ " << std::setw(8) 
-              << std::setprecision(2) << singleTime / multiMutexTime << "x  │\n";
-    std::cout << "└────────────────────────────────┴──────────────┴────────────┘\n";
+    // Sorted unique trainer ids and derived bitsets; equal queries have
+    // equal canonical text after this
+    QuerySpec& normalize() {
+        weekdayMask &= 0x7F;
+        std::sort(trainerIds.begin(), trainerIds.end());
+        trainerIds.erase(std::unique(trainerIds.begin(), trainerIds.end()), trainerIds.end());
+        trainerBits.clear();
+        trainerZoneBits = 0;
+        if (!trainerIds.empty()) {
+            trainerBits.assign(trainerIds.back() / 64 + 1, 0);
+            for (uint16_t id : trainerIds) {
+                trainerBits[id >> 6] |= uint64_t(1) << (id & 63);
+                trainerZoneBits |= trainerBit(id);
+            }
+        }
+        return *this;
+    }
     
-    // Display sample results
-    std::cout << "\n" << std::string(60, '=') << "\n";
-    std::cout << "ПРИМЕРЫ НАЙДЕННЫХ ЗАПИСЕЙ (первые 10):\n";
-    std::cout << std::string(60, '=') << "\n";
-    std::cout << "Тренировки в " << DAY_NAMES[targetDay] << ":\n\n";
+    // Canonical text, e.g. "weekday=1,3 date=2024-03-01..2024-03-31 time=08:00..11:59 trainer=0,5"
+    std::string toString() const {
+        std::ostringstream oss;
+        oss << std::setfill('0');
+        const char* sep = "";
+        if (weekdayMask != 0x7F) {
+            oss << "weekday=";
+            for (int d = 0, n = 0; d < 7; ++d) {
+                if ((weekdayMask >> d) & 1) oss << (n++ ? "," : "") << d;
+            }
+            sep = " ";
+        }
+        auto isoDate = [&](int32_t days) {
+            Date d = Date::fromDays(days);
+            oss << std::setw(4) << d.year << "-" << std::setw(2) << d.month << "-" << std::setw(2) << d.day;
+        };
+        if (fromDays != INT32_MIN || toDays != INT32_MAX) {
+            oss << sep << "date=";
+            if (fromDays != INT32_MIN) isoDate(fromDays);
+            oss << "..";
+            if (toDays != INT32_MAX) isoDate(toDays);
+            sep = " ";
+        }
+        if (fromMinutes != 0 || toMinutes != 24 * 60 - 1) {
+            oss << sep << "time=" << std::setw(2) << fromMinutes / 60 << ":" << std::setw(2) << fromMinutes % 60
+                << ".." << std::setw(2) << toMinutes / 60 << ":" << std::setw(2) << toMinutes % 60;
+            sep = " ";
+        }
+        if (!trainerIds.empty()) {
+            oss << sep << "trainer=";
+            for (size_t i = 0; i < trainerIds.size(); ++i) oss << (i ? "," : "") << trainerIds[i];
+        }
+        return oss.str();
+    }
     
-    size_t displayCount = std::min(singleResult.size(), size_t(10));
-    for (size_t i = 0; i < displayCount; ++i) {
-        std::cout << std::setw(3) << (i + 1) << ". " << singleResult[i].toString() << "\n";
+private:
+    std::vector<uint64_t> trainerBits;  // up to the largest queried id
+    uint64_t trainerZoneBits = 0;
+
+    // Ids above the largest queried one fall outside trainerBits. Query
+    // entry points call requireNormalized() once, so rows are not checked
+    bool matchesTrainer(uint16_t id) const {
+        size_t word = id >> 6;
+        return word < trainerBits.size() && ((trainerBits[word] >> (id & 63)) & 1);
+    }
+    
+    bool mayMatchTrainers(uint64_t zoneTrainerBits) const {
+        return (zoneTrainerBits & trainerZoneBits) != 0;
+    }
+};
+
+// Called by query entry points on the caller's thread, before any worker
+// starts: predicates that need preparation throw here instead of in a worker
+template<TrainingPredicate Pred>
+void validatePredicate(const Pred& pred) {
+    if constexpr (requires { pred.requireNormalized(); }) {
+        pred.requireNormalized();
+    }
+}
+
+template<TrainingPredicate Pred>
+std::vector<RowId> findTrainings(const TrainingColumnsView& view, const Pred& pred, int numThreads) {
+    validatePredicate(pred);
+    std::vector<RowId> result;
+    countThenScatter(view.size(), numThreads,
+        [&](size_t k) { return pred(view, k); },
+        [&](size_t total) { result.resize(total); },
+        [&](size_t out, size_t k) { result[out] = static_cast<RowId>(k); });
+    return result;
+}
+
+std::vector<RowId> findTrainingsByDayColumns(
+    const TrainingColumnsView& view,
+    int dayOfWeek,
+    int numThreads)
+{
+    return findTrainings(view, WeekdayIs(dayOfWeek), numThreads);
+}
+
+// One parallel pass answering many queries. evalRow(k, emit) calls emit(q)
+// for every query q that row k matches. Threads keep per-query match lists
+// for their chunk; a prefix sum over chunks gives each list its offset in
+// the query's preallocated output, so every result stays in source order.
+template<typename EvalRow>
+std::vector<std::vector<RowId>> scanBatch(size_t count, size_t numQueries, int numThreads, EvalRow evalRow) {
+    std::vector<size_t> bounds = chunkBounds(count, numThreads);
+    std::vector<std::vector<std::vector<RowId>>> local(numThreads,
+        std::vector<std::vector<RowId>>(numQueries));
+    std::vector<std::thread> threads;
+    
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back([&, i]() {
+            auto& lists = local[i];
+            for (size_t k = bounds[i]; k < bounds[i + 1]; ++k) {
+                evalRow(k, [&](size_t q) { lists[q].push_back(static_cast<RowId>(k)); });
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    threads.clear();
+    
+    // offsets[q][i] - where thread i's matches for query q start
+    std::vector<std::vector<RowId>> results(numQueries);
+    std::vector<std::vector<size_t>> offsets(numQueries, std::vector<size_t>(numThreads + 1, 0));
+    for (size_t q = 0; q < numQueries; ++q) {
+        for (int i = 0; i < numThreads; ++i) {
+            offsets[q][i + 1] = offsets[q][i] + local[i][q].size();
+        }
+        results[q].resize(offsets[q][numThreads]);
+    }
+    
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back([&, i]() {
+            for (size_t q = 0; q < numQueries; ++q) {
+                std::copy(local[i][q].begin(), local[i][q].end(), results[q].begin() + offsets[q][i]);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    
+    return results;
+}
+
+// Queries of one type with different parameters, e.g. all seven WeekdayIs
+template<TrainingPredicate Pred>
+std::vector<std::vector<RowId>> runQueryBatch(
+    const TrainingColumnsView& view,
+    const std::vector<Pred>& queries,
+    int numThreads)
+{
+    return scanBatch(view.size(), queries.size(), numThreads,
+        [&](size_t k, auto emit) {
+            for (size_t q = 0; q < queries.size(); ++q) {
+                if (queries[q](view, k)) emit(q);
+            }
+        });
+}
+
+// Heterogeneous queries; the per-row loop over queries is unrolled at compile time
+template<TrainingPredicate... Preds>
+std::array<std::vector<RowId>, sizeof...(Preds)> runQueries(
+    const TrainingColumnsView& view,
+    int numThreads,
+    const Preds&... preds)
+{
+    auto predTuple = std::forward_as_tuple(preds...);
+    auto lists = scanBatch(view.size(), sizeof...(Preds), numThreads,
+        [&](size_t k, auto emit) {
+            [&]<size_t... Q>(std::index_sequence<Q...>) {
+                ((std::get<Q>(predTuple)(view, k) ? emit(Q) : void()), ...);
+            }(std::index_sequence_for<Preds...>{});
+        });
+    
+    std::array<std::vector<RowId>, sizeof...(Preds)> results;
+    for (size_t q = 0; q < results.size(); ++q) {
+        results[q] = std::move(lists[q]);
+    }
+    return results;
+}
+
+// ==================== Date-sorted Block Layout ====================
+
+// Optional storage mode: rows sorted by (date, time) and cut into
+// fixed-size blocks, each summarised by a ZoneMap. Scans skip blocks the
+// predicate rules out; row ids refer to the sorted columns.
+class BlockedTrainings {
+public:
+    static constexpr size_t BLOCK_ROWS = 4096;
+    
+    BlockedTrainings(const TrainingColumnsView& source, int numThreads) {
+        std::vector<RowId> order(source.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = static_cast<RowId>(i);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](RowId a, RowId b) {
+            if (source.days[a] != source.days[b]) return source.days[a] < source.days[b];
+            return source.minutes[a] < source.minutes[b];
+        });
+        
+        columns.resize(source.size());
+        columns.trainerNames.assign(source.trainerNames, source.trainerNames + source.trainerCount);
+        parallelFor(order.size(), numThreads, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                columns.days[i] = source.days[order[i]];
+                columns.minutes[i] = source.minutes[order[i]];
+                columns.trainers[i] = source.trainers[order[i]];
+            }
+        });
+        
+        zones.resize((source.size() + BLOCK_ROWS - 1) / BLOCK_ROWS);
+        parallelFor(zones.size(), numThreads, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                zones[b] = summarize(b);
+            }
+        });
+    }
+    
+    TrainingColumnsView view() const { return columns.view(); }
+    size_t blockCount() const { return zones.size(); }
+    const ZoneMap& zone(size_t block) const { return zones[block]; }
+    
+    size_t blockBegin(size_t block) const { return block * BLOCK_ROWS; }
+    size_t blockEnd(size_t block) const { return std::min(columns.size(), (block + 1) * BLOCK_ROWS); }
+    
+private:
+    TrainingColumns columns;
+    std::vector<ZoneMap> zones;
+    
+    ZoneMap summarize(size_t block) const {
+        ZoneMap z;
+        size_t begin = blockBegin(block);
+        size_t end = blockEnd(block);
+        z.minDays = columns.days[begin];       // sorted by date
+        z.maxDays = columns.days[end - 1];
+        z.minMinutes = UINT16_MAX;
+        for (size_t i = begin; i < end; ++i) {
+            z.minMinutes = std::min(z.minMinutes, columns.minutes[i]);
+            z.maxMinutes = std::max(z.maxMinutes, columns.minutes[i]);
+            z.trainerBits |= trainerBit(columns.trainers[i]);
+        }
+        // Consecutive dates cycle through the weekdays
+        for (int32_t d = z.minDays; d <= z.maxDays && z.weekdayMask != 0x7F; ++d) {
+            z.weekdayMask |= static_cast<uint8_t>(1u << weekdayFromDays(d));
+        }
+        return z;
+    }
+};
+
+struct PrunedScanResult {
+    std::vector<RowId> rows;
+    size_t blocksTotal = 0;
+    size_t blocksScanned = 0;
+};
+
+// Count-then-scatter over blocks: threads take contiguous block ranges,
+// blocks whose zone map rules the predicate out are never read
+template<TrainingPredicate Pred>
+PrunedScanResult findTrainingsPruned(const BlockedTrainings& blocked, const Pred& pred, int numThreads) {
+    validatePredicate(pred);
+    TrainingColumnsView view = blocked.view();
+    size_t numBlocks = blocked.blockCount();
+    std::vector<uint8_t> candidate(numBlocks);
+    std::vector<size_t> blockOffsets(numBlocks + 1, 0);
+    
+    parallelFor(numBlocks, numThreads, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            candidate[b] = pred.mayMatch(blocked.zone(b));
+            size_t matches = 0;
+            if (candidate[b]) {
+                for (size_t k = blocked.blockBegin(b); k < blocked.blockEnd(b); ++k) {
+                    matches += pred(view, k) ? 1 : 0;
+                }
+            }
+            blockOffsets[b + 1] = matches;
+        }
+    });
+    
+    PrunedScanResult result;
+    result.blocksTotal = numBlocks;
+    for (size_t b = 0; b < numBlocks; ++b) {
+        blockOffsets[b + 1] += blockOffsets[b];
+        result.blocksScanned += candidate[b];
+    }
+    result.rows.resize(blockOffsets[numBlocks]);
+    
+    parallelFor(numBlocks, numThreads, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            if (blockOffsets[b + 1] == blockOffsets[b]) continue;
+            size_t out = blockOffsets[b];
+            for (size_t k = blocked.blockBegin(b); k < blocked.blockEnd(b); ++k) {
+                if (pred(view, k)) {
+                    result.rows[out++] = static_cast<RowId>(k);
+                }
+            }
+        }
+    });
+    
+    return result;
+}
+
+// ==================== Ordered and Top-K Results ====================
+
+enum class OrderBy { Date, Time, Trainer };
+
+struct QueryOrder {
+    OrderBy key = OrderBy::Date;
+    bool descending = false;
+    size_t limit = 0;  // 0 = no limit
+};
+
+// Row with its ordering packed into one integer; ties go to the lower row
+struct OrderedRow {
+    uint64_t key;
+    RowId row;
+    
+    bool operator<(const OrderedRow& other) const {
+        return key != other.key ? key < other.key : row < other.row;
+    }
+};
+
+class OrderKeyBuilder {
+public:
+    OrderKeyBuilder(const TrainingColumnsView& v, const QueryOrder& order)
+        : view(v), key(order.key), descending(order.descending)
+    {
+        if (key == OrderBy::Trainer) {
+            // Dictionary ids are in first-seen order; rank names instead
+            std::vector<uint16_t> ids(view.trainerCount);
+            for (size_t i = 0; i < ids.size(); ++i) ids[i] = static_cast<uint16_t>(i);
+            std::sort(ids.begin(), ids.end(), [&](uint16_t a, uint16_t b) {
+                return view.trainerNames[a] < view.trainerNames[b];
+            });
+            trainerRank.resize(ids.size());
+            for (size_t r = 0; r < ids.size(); ++r) trainerRank[ids[r]] = static_cast<uint16_t>(r);
+        }
+    }
+    
+    OrderedRow operator()(size_t row) const {
+        uint64_t day = static_cast<uint32_t>(view.days[row]) ^ 0x80000000u;  // signed -> unsigned order
+        uint64_t minute = view.minutes[row];
+        uint64_t k = 0;
+        switch (key) {
+            case OrderBy::Date:    k = day << 16 | minute; break;
+            case OrderBy::Time:    k = minute << 32 | day; break;
+            case OrderBy::Trainer: k = uint64_t(trainerRank[view.trainers[row]]) << 48 | day << 16 | minute; break;
+        }
+        return {descending ? ~k : k, static_cast<RowId>(row)};
+    }
+    
+private:
+    const TrainingColumnsView& view;
+    OrderBy key;
+    bool descending;
+    std::vector<uint16_t> trainerRank;
+};
+
+// Sorts chunks in parallel, then merges pairs of runs in parallel rounds,
+// ping-ponging between the input and one scratch buffer
+template<typename T>
+void parallelMergeSort(std::vector<T>& items, int numThreads) {
+    std::vector<size_t> runs = chunkBounds(items.size(), numThreads);
+    parallelFor(numThreads, numThreads, [&](size_t i, size_t) {
+        std::sort(items.begin() + runs[i], items.begin() + runs[i + 1]);
+    });
+    
+    std::vector<T> scratch(items.size());
+    std::vector<T>* src = &items;
+    std::vector<T>* dst = &scratch;
+    while (runs.size() > 2) {
+        size_t numRuns = runs.size() - 1;
+        std::vector<size_t> merged;
+        for (size_t r = 0; r < numRuns; r += 2) merged.push_back(runs[r]);
+        merged.push_back(runs.back());
+        
+        std::vector<std::thread> threads;
+        for (size_t r = 0; r < numRuns; r += 2) {
+            threads.emplace_back([&, r]() {
+                // An odd run out is merged with an empty range, i.e. copied
+                auto first = src->begin();
+                size_t mid = runs[r + 1];
+                size_t end = r + 2 <= numRuns ? runs[r + 2] : mid;
+                std::merge(first + runs[r], first + mid, first + mid, first + end, dst->begin() + runs[r]);
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        std::swap(src, dst);
+        runs = std::move(merged);
+    }
+    if (src != &items) {
+        items.swap(scratch);
+    }
+}
+
+// Matching rows in the requested order. Without a limit the matches are
+// sorted with parallelMergeSort; with a limit every thread keeps a bounded
+// max-heap of its best `limit` rows, so the full match set is never built.
+template<TrainingPredicate Pred>
+std::vector<RowId> findTrainingsOrdered(const TrainingColumnsView& view, const Pred& pred,
+                                        const QueryOrder& order, int numThreads) {
+    validatePredicate(pred);
+    OrderKeyBuilder keyOf(view, order);
+    std::vector<OrderedRow> best;
+    
+    if (order.limit == 0) {
+        countThenScatter(view.size(), numThreads,
+            [&](size_t k) { return pred(view, k); },
+            [&](size_t total) { best.resize(total); },
+            [&](size_t out, size_t k) { best[out] = keyOf(k); });
+        parallelMergeSort(best, numThreads);
+    } else {
+        std::vector<std::vector<OrderedRow>> heaps(numThreads);
+        std::vector<size_t> bounds = chunkBounds(view.size(), numThreads);
+        parallelFor(numThreads, numThreads, [&](size_t i, size_t) {
+            auto& heap = heaps[i];
+            heap.reserve(order.limit + 1);
+            for (size_t k = bounds[i]; k < bounds[i + 1]; ++k) {
+                if (!pred(view, k)) continue;
+                OrderedRow candidate = keyOf(k);
+                if (heap.size() < order.limit) {
+                    heap.push_back(candidate);
+                    std::push_heap(heap.begin(), heap.end());
+                } else if (candidate < heap.front()) {
+                    std::pop_heap(heap.begin(), heap.end());
+                    heap.back() = candidate;
+                    std::push_heap(heap.begin(), heap.end());
+                }
+            }
+        });
+        for (const auto& heap : heaps) {
+            best.insert(best.end(), heap.begin(), heap.end());
+        }
+        size_t keep = std::min(order.limit, best.size());
+        std::partial_sort(best.begin(), best.begin() + keep, best.end());
+        best.resize(keep);
+    }
+    
+    std::vector<RowId> rows(best.size());
+    for (size_t i = 0; i < best.size(); ++i) {
+        rows[i] = best[i].row;
+    }
+    return rows;
+}
+
+// Orders an already computed match set, e.g. a cached query result,
+// without scanning the dataset again
+std::vector<RowId> orderRows(const TrainingColumnsView& view, const std::vector<RowId>& matches,
+                             const QueryOrder& order, int numThreads) {
+    OrderKeyBuilder keyOf(view, order);
+    std::vector<OrderedRow> keyed(matches.size());
+    parallelFor(matches.size(), numThreads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) keyed[i] = keyOf(matches[i]);
+    });
+    
+    size_t keep = order.limit == 0 ? keyed.size() : std::min(order.limit, keyed.size());
+    if (keep < keyed.size()) {
+        std::partial_sort(keyed.begin(), keyed.begin() + keep, keyed.end());
+    } else {
+        parallelMergeSort(keyed, numThreads);
+    }
+    
+    std::vector<RowId> rows(keep);
+    for (size_t i = 0; i < keep; ++i) {
+        rows[i] = keyed[i].row;
+    }
+    return rows;
+}
+
+// ==================== Group-by Aggregation ====================
+
+enum class GroupDimension { Trainer, Weekday, Month, Hour };
+
+struct AllRows : PredicateBase {
+    bool operator()(const TrainingColumnsView&, size_t) const { return true; }
+    bool mayMatch(const ZoneMap&) const { return true; }
+};
+
+// Dense count table; the last dimension varies fastest
+struct GroupCounts {
+    std::vector<GroupDimension> dimensions;
+    std::vector<size_t> extents;
+    std::vector<uint64_t> counts;
+    
+    uint64_t at(std::initializer_list<size_t> coords) const {
+        size_t index = 0;
+        size_t d = 0;
+        for (size_t c : coords) {
+            index = index * extents[d++] + c;
+        }
+        return counts[index];
+    }
+};
+
+size_t dimensionExtent(GroupDimension dim, const TrainingColumnsView& view) {
+    switch (dim) {
+        case GroupDimension::Trainer: return view.trainerCount;
+        case GroupDimension::Weekday: return 7;
+        case GroupDimension::Month: return 12;
+        case GroupDimension::Hour: return 24;
+    }
+    return 0;
+}
+
+// Counts rows matching `filter` into every requested table in one parallel
+// pass. Each thread accumulates into its own dense arrays, which are then
+// combined by a pairwise tree reduction (log2(threads) parallel rounds).
+template<TrainingPredicate Pred = AllRows>
+std::vector<GroupCounts> aggregateTrainings(
+    const TrainingColumnsView& view,
+    const std::vector<std::vector<GroupDimension>>& tables,
+    int numThreads,
+    const Pred& filter = Pred())
+{
+    // Flat layout of all tables inside one accumulator per thread
+    std::vector<GroupCounts> results(tables.size());
+    std::vector<size_t> tableOffsets(tables.size() + 1, 0);
+    bool needMonth = false;
+    for (size_t t = 0; t < tables.size(); ++t) {
+        size_t cells = 1;
+        results[t].dimensions = tables[t];
+        for (GroupDimension dim : tables[t]) {
+            results[t].extents.push_back(dimensionExtent(dim, view));
+            cells *= results[t].extents.back();
+            needMonth = needMonth || dim == GroupDimension::Month;
+        }
+        tableOffsets[t + 1] = tableOffsets[t] + cells;
+    }
+    size_t totalCells = tableOffsets.back();
+    
+    std::vector<std::vector<uint64_t>> accumulators(numThreads);
+    parallelFor(numThreads, numThreads, [&](size_t begin, size_t) {
+        accumulators[begin].assign(totalCells, 0);
+    });
+    
+    std::vector<size_t> bounds = chunkBounds(view.size(), numThreads);
+    parallelFor(numThreads, numThreads, [&](size_t thread, size_t) {
+        uint64_t* acc = accumulators[thread].data();
+        for (size_t k = bounds[thread]; k < bounds[thread + 1]; ++k) {
+            if (!filter(view, k)) continue;
+            
+            size_t values[4];
+            values[static_cast<int>(GroupDimension::Trainer)] = view.trainers[k];
+            values[static_cast<int>(GroupDimension::Weekday)] = static_cast<size_t>(view.weekday(k));
+            values[static_cast<int>(GroupDimension::Month)] =
+                needMonth ? static_cast<size_t>(Date::fromDays(view.days[k]).month - 1) : 0;
+            values[static_cast<int>(GroupDimension::Hour)] = view.minutes[k] / 60u;
+            
+            for (size_t t = 0; t < results.size(); ++t) {
+                size_t index = 0;
+                for (size_t d = 0; d < results[t].dimensions.size(); ++d) {
+                    index = index * results[t].extents[d] + values[static_cast<int>(results[t].dimensions[d])];
+                }
+                ++acc[tableOffsets[t] + index];
+            }
+        }
+    });
+    
+    // Tree reduction: in round r, accumulator i absorbs accumulator i + 2^r
+    for (size_t stride = 1; stride < accumulators.size(); stride *= 2) {
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i + stride < accumulators.size(); i += 2 * stride) {
+            threads.emplace_back([&, i, stride]() {
+                auto& dst = accumulators[i];
+                const auto& src = accumulators[i + stride];
+                for (size_t c = 0; c < totalCells; ++c) {
+                    dst[c] += src[c];
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+    
+    for (size_t t = 0; t < results.size(); ++t) {
+        results[t].counts.assign(accumulators[0].begin() + tableOffsets[t],
+                                 accumulators[0].begin() + tableOffsets[t + 1]);
+    }
+    return results;
+}
+
+// ==================== Weekday Partitioning ====================
+
+// Allocator for buffers whose first element starts a 64-byte cache line
+template<typename T>
+struct CacheLineAllocator {
+    using value_type = T;
+    
+    CacheLineAllocator() = default;
+    template<typename U>
+    CacheLineAllocator(const CacheLineAllocator<U>&) {}
+    
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{64}));
+    }
+    void deallocate(T* p, size_t) {
+        ::operator delete(p, std::align_val_t{64});
+    }
+    
+    template<typename U>
+    bool operator==(const CacheLineAllocator<U>&) const { return true; }
+};
+
+// Row in the packed layout produced by partitioning
+struct PackedTraining {
+    int32_t days;
+    uint16_t minutes;
+    uint16_t trainer;
+};
+
+// All rows grouped by weekday: day d occupies [offsets[d], offsets[d + 1])
+// of one contiguous array, in source order within each day
+struct WeekdayPartitions {
+    std::vector<PackedTraining, CacheLineAllocator<PackedTraining>> records;
+    std::array<size_t, 8> offsets{};
+    
+    const PackedTraining* begin(int day) const { return records.data() + offsets[day]; }
+    const PackedTraining* end(int day) const { return records.data() + offsets[day + 1]; }
+    size_t size(int day) const { return offsets[day + 1] - offsets[day]; }
+};
+
+// Radix partition on the weekday. Threads build histograms of their chunk
+// (reading only the day column), a prefix sum over (day, thread) gives every
+// thread a private output range per day, and the scatter goes through a
+// cache-line sized write-combining buffer per day. The buffer mirrors the
+// output line the cursor is in, so after a partial head up to the next line
+// boundary every flush writes one whole aligned 64-byte line instead of
+// seven interleaved 8-byte streams; only the head and tail of each range
+// are partial.
+WeekdayPartitions partitionByWeekday(const TrainingColumnsView& view, int numThreads) {
+    constexpr size_t LINE_RECORDS = 64 / sizeof(PackedTraining);
+    std::vector<size_t> bounds = chunkBounds(view.size(), numThreads);
+    std::vector<std::array<size_t, 7>> histograms(numThreads);
+    
+    parallelFor(numThreads, numThreads, [&](size_t t, size_t) {
+        std::array<size_t, 7> h{};
+        for (size_t k = bounds[t]; k < bounds[t + 1]; ++k) {
+            ++h[view.weekday(k)];
+        }
+        histograms[t] = h;
+    });
+    
+    // Day-major prefix sum: all of Sunday (thread 0, 1, ...), then Monday...
+    WeekdayPartitions result;
+    std::vector<std::array<size_t, 7>> cursors(numThreads);
+    size_t running = 0;
+    for (int d = 0; d < 7; ++d) {
+        result.offsets[d] = running;
+        for (int t = 0; t < numThreads; ++t) {
+            cursors[t][d] = running;
+            running += histograms[t][d];
+        }
+    }
+    result.offsets[7] = running;
+    result.records.resize(running);
+    
+    parallelFor(numThreads, numThreads, [&](size_t t, size_t) {
+        struct alignas(64) Line {
+            PackedTraining rows[LINE_RECORDS];
+        };
+        Line buffers[7];
+        std::array<size_t, 7>& out = cursors[t];
+        // Slots before head[d] belong to rows outside this thread's range
+        size_t head[7], filled[7];
+        for (int d = 0; d < 7; ++d) {
+            head[d] = filled[d] = out[d] % LINE_RECORDS;
+        }
+        PackedTraining* dst = result.records.data();
+        
+        for (size_t k = bounds[t]; k < bounds[t + 1]; ++k) {
+            int d = view.weekday(k);
+            buffers[d].rows[filled[d]++] = {view.days[k], view.minutes[k], view.trainers[k]};
+            if (filled[d] == LINE_RECORDS) {
+                std::memcpy(dst + out[d], buffers[d].rows + head[d], (LINE_RECORDS - head[d]) * sizeof(PackedTraining));
+                out[d] += LINE_RECORDS - head[d];
+                head[d] = filled[d] = 0;
+            }
+        }
+        for (int d = 0; d < 7; ++d) {
+            std::memcpy(dst + out[d], buffers[d].rows + head[d], (filled[d] - head[d]) * sizeof(PackedTraining));
+        }
+    });
+    
+    return result;
+}
+
+// ==================== Binary File Format ====================
+//
+// Little-endian file, every section starts on a 64-byte boundary:
+//   TrainingFileHeader | days[int32] | minutes[uint16] | trainers[uint16] | dictionary
+// The dictionary is trainerCount entries of (uint32 length, UTF-8 bytes).
+// Column sections may have spare capacity past recordCount (the importer
+// sizes them from the line count), readers must rely on the header offsets.
+
+constexpr char TRAINING_FILE_MAGIC[8] = {'T', 'R', 'N', 'G', 'C', 'O', 'L', '\0'};
+constexpr uint32_t TRAINING_FILE_VERSION = 1;
+constexpr uint64_t TRAINING_FILE_ALIGN = 64;
+
+struct TrainingFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t trainerCount;
+    uint64_t recordCount;
+    uint64_t daysOffset;
+    uint64_t minutesOffset;
+    uint64_t trainersOffset;
+    uint64_t dictionaryOffset;
+    uint64_t dictionaryBytes;
+};
+
+inline uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// True if `count` items of `itemSize` bytes at an aligned `offset` lie
+// within a file of `fileSize` bytes; written so a corrupt header cannot
+// overflow the arithmetic
+inline bool sectionFits(uint64_t offset, uint64_t count, uint64_t itemSize, uint64_t fileSize) {
+    return offset % TRAINING_FILE_ALIGN == 0 && offset <= fileSize &&
+           count <= (fileSize - offset) / itemSize;
+}
+
+// Section offsets for a file whose columns can hold `capacity` records
+TrainingFileHeader makeTrainingFileHeader(uint64_t capacity) {
+    TrainingFileHeader header{};
+    std::memcpy(header.magic, TRAINING_FILE_MAGIC, sizeof(header.magic));
+    header.version = TRAINING_FILE_VERSION;
+    header.daysOffset = alignUp(sizeof(TrainingFileHeader), TRAINING_FILE_ALIGN);
+    header.minutesOffset = alignUp(header.daysOffset + capacity * sizeof(int32_t), TRAINING_FILE_ALIGN);
+    header.trainersOffset = alignUp(header.minutesOffset + capacity * sizeof(uint16_t), TRAINING_FILE_ALIGN);
+    header.dictionaryOffset = alignUp(header.trainersOffset + capacity * sizeof(uint16_t), TRAINING_FILE_ALIGN);
+    return header;
+}
+
+std::string encodeDictionary(const std::vector<std::string>& names) {
+    std::string bytes;
+    for (const auto& name : names) {
+        uint32_t length = static_cast<uint32_t>(name.size());
+        bytes.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        bytes.append(name);
+    }
+    return bytes;
+}
+
+// pwrite() the whole buffer, retrying short writes
+void writeAt(int fd, const void* data, size_t bytes, uint64_t offset) {
+    const char* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t written = ::pwrite(fd, p, bytes, static_cast<off_t>(offset));
+        if (written < 0) {
+            throw std::runtime_error(std::string("Ошибка записи: ") + std::strerror(errno));
+        }
+        p += written;
+        bytes -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+}
+
+// Writes the header and dictionary once the columns are in place
+void finishTrainingFile(int fd, TrainingFileHeader header, uint64_t recordCount,
+                        const std::vector<std::string>& trainerNames) {
+    std::string dictionary = encodeDictionary(trainerNames);
+    header.recordCount = recordCount;
+    header.trainerCount = static_cast<uint32_t>(trainerNames.size());
+    header.dictionaryBytes = dictionary.size();
+    writeAt(fd, dictionary.data(), dictionary.size(), header.dictionaryOffset);
+    writeAt(fd, &header, sizeof(header), 0);
+    if (::ftruncate(fd, static_cast<off_t>(header.dictionaryOffset + dictionary.size())) != 0) {
+        throw std::runtime_error(std::string("Ошибка ftruncate: ") + std::strerror(errno));
+    }
+}
+
+void writeTrainingFile(const std::string& path, const TrainingColumnsView& view) {
+    int fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Не удалось создать " + path + ": " + std::strerror(errno));
+    }
+    try {
+        TrainingFileHeader header = makeTrainingFileHeader(view.size());
+        writeAt(fd, view.days, view.size() * sizeof(int32_t), header.daysOffset);
+        writeAt(fd, view.minutes, view.size() * sizeof(uint16_t), header.minutesOffset);
+        writeAt(fd, view.trainers, view.size() * sizeof(uint16_t), header.trainersOffset);
+        finishTrainingFile(fd, header, view.size(),
+            std::vector<std::string>(view.trainerNames, view.trainerNames + view.trainerCount));
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+}
+
+// Memory-mapped training file; columns are queried in place through view()
+class MappedTrainingFile {
+private:
+    void* mapping = MAP_FAILED;
+    size_t mappingSize = 0;
+    std::vector<std::string> trainerNames;
+    TrainingColumnsView columns;
+    
+public:
+    explicit MappedTrainingFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Не удалось открыть " + path + ": " + std::strerror(errno));
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(TrainingFileHeader)) {
+            ::close(fd);
+            throw std::runtime_error("Файл слишком мал: " + path);
+        }
+        mappingSize = static_cast<size_t>(st.st_size);
+        mapping = ::mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("Ошибка mmap: " + path);
+        }
+        try {
+            parse(path);
+        } catch (...) {
+            ::munmap(mapping, mappingSize);
+            throw;
+        }
+    }
+    
+    ~MappedTrainingFile() {
+        if (mapping != MAP_FAILED) {
+            ::munmap(mapping, mappingSize);
+        }
+    }
+    
+    MappedTrainingFile(const MappedTrainingFile&) = delete;
+    MappedTrainingFile& operator=(const MappedTrainingFile&) = delete;
+    
+    const TrainingColumnsView& view() const { return columns; }
+    
+private:
+    void parse(const std::string& path) {
+        const char* base = static_cast<const char*>(mapping);
+        TrainingFileHeader header;
+        std::memcpy(&header, base, sizeof(header));
+        
+        if (std::memcmp(header.magic, TRAINING_FILE_MAGIC, sizeof(header.magic)) != 0) {
+            throw std::runtime_error("Неверный формат файла: " + path);
+        }
+        if (header.version != TRAINING_FILE_VERSION) {
+            throw std::runtime_error("Неподдерживаемая версия формата " +
+                std::to_string(header.version) + ": " + path);
+        }
+        uint64_t n = header.recordCount;
+        if (n > UINT32_MAX ||
+            !sectionFits(header.daysOffset, n, sizeof(int32_t), mappingSize) ||
+            !sectionFits(header.minutesOffset, n, sizeof(uint16_t), mappingSize) ||
+            !sectionFits(header.trainersOffset, n, sizeof(uint16_t), mappingSize) ||
+            !sectionFits(header.dictionaryOffset, header.dictionaryBytes, 1, mappingSize)) {
+            throw std::runtime_error("Файл повреждён (секции за концом файла): " + path);
+        }
+        
+        const char* dict = base + header.dictionaryOffset;
+        const char* dictEnd = dict + header.dictionaryBytes;
+        for (uint32_t i = 0; i < header.trainerCount; ++i) {
+            uint32_t length;
+            if (dict + sizeof(length) > dictEnd) {
+                throw std::runtime_error("Файл повреждён (словарь тренеров): " + path);
+            }
+            std::memcpy(&length, dict, sizeof(length));
+            dict += sizeof(length);
+            if (dict + length > dictEnd) {
+                throw std::runtime_error("Файл повреждён (словарь тренеров): " + path);
+            }
+            trainerNames.emplace_back(dict, length);
+            dict += length;
+        }
+        
+        columns.days = reinterpret_cast<const int32_t*>(base + header.daysOffset);
+        columns.minutes = reinterpret_cast<const uint16_t*>(base + header.minutesOffset);
+        columns.trainers = reinterpret_cast<const uint16_t*>(base + header.trainersOffset);
+        columns.count = n;
+        
+        // Queries index the dictionary with these ids unchecked
+        uint16_t maxTrainer = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            maxTrainer = std::max(maxTrainer, columns.trainers[i]);
+        }
+        if (n > 0 && maxTrainer >= trainerNames.size()) {
+            throw std::runtime_error("Файл повреждён (номер тренера вне словаря): " + path);
+        }
+        columns.trainerNames = trainerNames.data();
+        columns.trainerCount = trainerNames.size();
+    }
+};
+
+// ==================== CSV Import ====================
+//
+// Line format: <dd.mm.yyyy or yyyy-mm-dd>,<hh:mm>,<trainer name>
+// The name may be wrapped in double quotes. Lines that do not parse
+// (header, blank lines, garbage) are skipped and counted.
+
+// Parses an unsigned decimal of exactly `digits` characters
+inline bool parseDigits(const char*& p, const char* end, int digits, int& value) {
+    if (end - p < digits) return false;
+    value = 0;
+    for (int i = 0; i < digits; ++i) {
+        if (p[i] < '0' || p[i] > '9') return false;
+        value = value * 10 + (p[i] - '0');
+    }
+    p += digits;
+    return true;
+}
+
+inline bool expectChar(const char*& p, const char* end, char c) {
+    if (p >= end || *p != c) return false;
+    ++p;
+    return true;
+}
+
+bool parseCsvLine(const char* p, const char* end, int& days, int& minutes, std::string_view& name) {
+    while (end > p && (end[-1] == '\r' || end[-1] == ' ')) --end;
+    
+    Date d;
+    if (end - p >= 10 && p[4] == '-') {
+        if (!parseDigits(p, end, 4, d.year) || !expectChar(p, end, '-') ||
+            !parseDigits(p, end, 2, d.month) || !expectChar(p, end, '-') ||
+            !parseDigits(p, end, 2, d.day)) return false;
+    } else {
+        if (!parseDigits(p, end, 2, d.day) || !expectChar(p, end, '.') ||
+            !parseDigits(p, end, 2, d.month) || !expectChar(p, end, '.') ||
+            !parseDigits(p, end, 4, d.year)) return false;
+    }
+    if (!d.isValid()) return false;
+    
+    int h, m;
+    if (!expectChar(p, end, ',') || !parseDigits(p, end, 2, h) || !expectChar(p, end, ':') ||
+        !parseDigits(p, end, 2, m) || !expectChar(p, end, ',')) return false;
+    if (h > 23 || m > 59) return false;
+    
+    if (end - p >= 2 && *p == '"' && end[-1] == '"') {
+        ++p;
+        --end;
+    }
+    if (p == end) return false;
+    
+    days = d.toDays();
+    minutes = h * 60 + m;
+    name = std::string_view(p, static_cast<size_t>(end - p));
+    return true;
+}
+
+// Parsed slice of one block, trainer ids are local to the slice until remapped
+struct CsvSliceColumns {
+    std::vector<int32_t> days;
+    std::vector<uint16_t> minutes;
+    std::vector<uint16_t> trainers;
+    std::vector<std::string> localNames;
+    size_t skippedLines = 0;
+    bool tooManyTrainers = false;  // parsing stopped: local ids ran out of 16 bits
+};
+
+void parseCsvSlice(const char* begin, const char* end, CsvSliceColumns& out) {
+    std::unordered_map<std::string_view, uint16_t> localIds;
+    const char* line = begin;
+    while (line < end) {
+        const char* eol = static_cast<const char*>(std::memchr(line, '\n', end - line));
+        if (!eol) eol = end;
+        
+        int days, minutes;
+        std::string_view name;
+        if (parseCsvLine(line, eol, days, minutes, name)) {
+            auto it = localIds.find(name);
+            if (it == localIds.end()) {
+                if (out.localNames.size() > UINT16_MAX) {
+                    out.tooManyTrainers = true;
+                    return;
+                }
+                out.localNames.emplace_back(name);
+                it = localIds.emplace(name, static_cast<uint16_t>(out.localNames.size() - 1)).first;
+            }
+            out.days.push_back(days);
+            out.minutes.push_back(static_cast<uint16_t>(minutes));
+            out.trainers.push_back(it->second);
+        } else if (eol > line) {
+            ++out.skippedLines;
+        }
+        line = eol + 1;
+    }
+}
+
+struct CsvImportStats {
+    uint64_t records = 0;
+    uint64_t skippedLines = 0;
+    uint64_t bytesRead = 0;
+    size_t trainers = 0;
+};
+
+// Streams the CSV in fixed-size blocks: pass 1 counts lines to size the
+// column sections, pass 2 splits every block on line boundaries, parses the
+// slices in parallel and pwrite()s each slice at its prefix-sum offset.
+// Memory use is bounded by the block size, not by the input size.
+CsvImportStats importCsvToTrainingFile(const std::string& csvPath, const std::string& outPath,
+                                       int numThreads, size_t blockSize = 16 << 20) {
+    int in = ::open(csvPath.c_str(), O_RDONLY);
+    if (in < 0) {
+        throw std::runtime_error("Не удалось открыть " + csvPath + ": " + std::strerror(errno));
+    }
+    int out = ::open(outPath.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (out < 0) {
+        ::close(in);
+        throw std::runtime_error("Не удалось создать " + outPath + ": " + std::strerror(errno));
+    }
+    
+    CsvImportStats stats;
+    std::vector<char> buffer(blockSize);
+    
+    auto closeBoth = [&]() {
+        ::close(in);
+        ::close(out);
+    };
+    auto readSome = [&](char* dst, size_t bytes) {
+        ssize_t got = ::read(in, dst, bytes);
+        if (got < 0) {
+            throw std::runtime_error(std::string("Ошибка чтения: ") + std::strerror(errno));
+        }
+        return static_cast<size_t>(got);
+    };
+    
+    try {
+        // Pass 1: line count is an upper bound on the record count
+        uint64_t lines = 0;
+        bool endsWithNewline = true;
+        for (size_t got; (got = readSome(buffer.data(), buffer.size())) > 0; ) {
+            lines += static_cast<uint64_t>(std::count(buffer.data(), buffer.data() + got, '\n'));
+            endsWithNewline = buffer[got - 1] == '\n';
+        }
+        uint64_t capacity = lines + (endsWithNewline ? 0 : 1);
+        if (capacity > UINT32_MAX) {
+            throw std::runtime_error("Слишком много строк для 32-битных номеров записей");
+        }
+        if (::lseek(in, 0, SEEK_SET) != 0) {
+            throw std::runtime_error("Не удалось перемотать " + csvPath);
+        }
+        
+        TrainingFileHeader header = makeTrainingFileHeader(capacity);
+        std::vector<std::string> trainerNames;
+        std::unordered_map<std::string, uint16_t> trainerIds;
+        
+        // Pass 2: parse block by block, carrying the partial last line over
+        size_t carried = 0;
+        bool eof = false;
+        while (!eof || carried > 0) {
+            size_t filled = carried;
+            while (!eof && filled < buffer.size()) {
+                size_t got = readSome(buffer.data() + filled, buffer.size() - filled);
+                if (got == 0) eof = true;
+                filled += got;
+                stats.bytesRead += got;
+            }
+            
+            // Process up to the last newline unless this is the final block
+            size_t usable = filled;
+            if (!eof) {
+                const char* lastNl = nullptr;
+                for (size_t k = filled; k > 0; --k) {
+                    if (buffer[k - 1] == '\n') {
+                        lastNl = buffer.data() + k - 1;
+                        break;
+                    }
+                }
+                if (!lastNl) {
+                    throw std::runtime_error("Строка длиннее блока чтения");
+                }
+                usable = static_cast<size_t>(lastNl - buffer.data()) + 1;
+            }
+            
+            // Slice boundaries moved forward to the next line start
+            std::vector<size_t> bounds = chunkBounds(usable, numThreads);
+            for (int i = 1; i < numThreads; ++i) {
+                size_t b = std::max(bounds[i], bounds[i - 1]);
+                while (b > 0 && b < usable && buffer[b - 1] != '\n') ++b;
+                bounds[i] = b;
+            }
+            
+            std::vector<CsvSliceColumns> slices(numThreads);
+            std::vector<std::thread> threads;
+            for (int i = 0; i < numThreads; ++i) {
+                threads.emplace_back([&, i]() {
+                    parseCsvSlice(buffer.data() + bounds[i], buffer.data() + bounds[i + 1], slices[i]);
+                });
+            }
+            for (auto& t : threads) {
+                t.join();
+            }
+            threads.clear();
+            
+            // Remap slice-local trainer ids to the global dictionary and
+            // compute every slice's output offset
+            std::vector<uint64_t> offsets(numThreads + 1, stats.records);
+            for (int i = 0; i < numThreads; ++i) {
+                CsvSliceColumns& slice = slices[i];
+                if (slice.tooManyTrainers) {
+                    throw std::runtime_error("Слишком много тренеров для 16-битного словаря");
+                }
+                std::vector<uint16_t> globalIds(slice.localNames.size());
+                for (size_t k = 0; k < slice.localNames.size(); ++k) {
+                    auto it = trainerIds.find(slice.localNames[k]);
+                    if (it == trainerIds.end()) {
+                        if (trainerNames.size() > UINT16_MAX) {
+                            throw std::runtime_error("Слишком много тренеров для 16-битного словаря");
+                        }
+                        it = trainerIds.emplace(slice.localNames[k],
+                            static_cast<uint16_t>(trainerNames.size())).first;
+                        trainerNames.push_back(slice.localNames[k]);
+                    }
+                    globalIds[k] = it->second;
+                }
+                for (auto& id : slice.trainers) {
+                    id = globalIds[id];
+                }
+                offsets[i + 1] = offsets[i] + slice.days.size();
+                stats.skippedLines += slice.skippedLines;
+            }
+            
+            // Each slice lands in its own range of every column section
+            for (int i = 0; i < numThreads; ++i) {
+                threads.emplace_back([&, i]() {
+                    const CsvSliceColumns& slice = slices[i];
+                    uint64_t row = offsets[i];
+                    writeAt(out, slice.days.data(), slice.days.size() * sizeof(int32_t),
+                            header.daysOffset + row * sizeof(int32_t));
+                    writeAt(out, slice.minutes.data(), slice.minutes.size() * sizeof(uint16_t),
+                            header.minutesOffset + row * sizeof(uint16_t));
+                    writeAt(out, slice.trainers.data(), slice.trainers.size() * sizeof(uint16_t),
+                            header.trainersOffset + row * sizeof(uint16_t));
+                });
+            }
+            for (auto& t : threads) {
+                t.join();
+            }
+            stats.records = offsets[numThreads];
+            
+            carried = filled - usable;
+            std::memmove(buffer.data(), buffer.data() + usable, carried);
+        }
+        
+        finishTrainingFile(out, header, stats.records, trainerNames);
+        stats.trainers = trainerNames.size();
+    } catch (...) {
+        closeBoth();
+        throw;
+    }
+    closeBoth();
+    return stats;
+}
+
+void writeTrainingsCsv(const std::string& path, const std::vector<Training>& trainings) {
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("Не удалось создать " + path);
+    }
+    out << "date,time,trainer\n";
+    for (const auto& t : trainings) {
+        out << t.date.toString() << "," << t.time.toString() << "," << t.trainerName << "\n";
+    }
+}
+
+// ==================== Concurrent Append Store ====================
+//
+// Append-only store for a continuous stream of bookings. Rows live in
+// fixed-capacity segments that never move; the list of segments is an
+// immutable Directory replaced copy-on-write when a segment is added.
+// A snapshot is (directory, published row count): rows below the count
+// are never modified again, so queries read them without locks. Replaced
+// directories are freed by epoch-based reclamation once no snapshot that
+// could still see them is alive.
+
+// Epoch-based reclamation for objects of type T. Readers occupy one of a
+// fixed number of slots for the duration of a read-side section.
+template<typename T>
+class EpochReclaimer {
+public:
+    static constexpr size_t MAX_READERS = 128;
+    
+    ~EpochReclaimer() {
+        for (auto& r : retired) {
+            delete r.first;
+        }
+    }
+    
+    // Returns the slot to pass to leave(); lock-free, spins only when all
+    // MAX_READERS slots are busy
+    size_t enter() {
+        for (;;) {
+            for (size_t i = 0; i < MAX_READERS; ++i) {
+                uint64_t expected = 0;
+                uint64_t epoch = globalEpoch.load();
+                if (slots[i].epoch.compare_exchange_strong(expected, epoch)) {
+                    return i;
+                }
+            }
+            std::this_thread::yield();
+        }
+    }
+    
+    void leave(size_t slot) {
+        slots[slot].epoch.store(0, std::memory_order_release);
+    }
+    
+    // Called by the (serialized) writer after `object` was unlinked
+    void retire(const T* object) {
+        retired.emplace_back(object, globalEpoch.fetch_add(1));
+        reclaim();
+    }
+    
+    size_t reclaimedCount() const { return reclaimed.load(std::memory_order_relaxed); }
+    
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};  // 0 = free
+    };
+    
+    std::atomic<uint64_t> globalEpoch{1};
+    Slot slots[MAX_READERS];
+    std::vector<std::pair<const T*, uint64_t>> retired;
+    std::atomic<size_t> reclaimed{0};
+    
+    // An object retired in epoch E is unreachable for readers that entered
+    // in a later epoch; only readers announced at E or earlier may hold it
+    void reclaim() {
+        uint64_t oldestActive = UINT64_MAX;
+        for (const auto& slot : slots) {
+            uint64_t e = slot.epoch.load();
+            if (e != 0) oldestActive = std::min(oldestActive, e);
+        }
+        auto keep = std::remove_if(retired.begin(), retired.end(), [&](const auto& r) {
+            if (r.second < oldestActive) {
+                delete r.first;
+                reclaimed.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        });
+        retired.erase(keep, retired.end());
+    }
+};
+
+class SegmentedTrainingStore {
+public:
+    static constexpr size_t SEGMENT_SHIFT = 16;
+    static constexpr size_t SEGMENT_ROWS = size_t(1) << SEGMENT_SHIFT;
+    
+    struct Segment {
+        std::unique_ptr<int32_t[]> days{new int32_t[SEGMENT_ROWS]};
+        std::unique_ptr<uint16_t[]> minutes{new uint16_t[SEGMENT_ROWS]};
+        std::unique_ptr<uint16_t[]> trainers{new uint16_t[SEGMENT_ROWS]};
+    };
+    
+    struct Directory {
+        std::vector<const Segment*> segments;
+    };
+    
+    // Consistent read-only view of the first rowCount rows
+    class Snapshot {
+    public:
+        Snapshot(const SegmentedTrainingStore& s)
+            : store(&s), slot(s.epochs.enter())
+        {
+            // Count first: the directory loaded afterwards covers every
+            // published row because the writer links segments before it
+            // publishes the rows in them. The directory load is seq_cst so
+            // it cannot move before the slot announcement in enter(); the
+            // writer's retire() scan would otherwise miss this reader
+            rowCount = s.publishedRows.load(std::memory_order_acquire);
+            directory = s.directory.load(std::memory_order_seq_cst);
+        }
+        ~Snapshot() { store->epochs.leave(slot); }
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+        
+        size_t size() const { return rowCount; }
+        size_t segmentCount() const { return (rowCount + SEGMENT_ROWS - 1) >> SEGMENT_SHIFT; }
+        
+        TrainingColumnsView segmentView(size_t segment) const {
+            const Segment* seg = directory->segments[segment];
+            size_t rows = std::min(SEGMENT_ROWS, rowCount - (segment << SEGMENT_SHIFT));
+            return {seg->days.get(), seg->minutes.get(), seg->trainers.get(), rows,
+                    store->trainerNames.data(), store->trainerNames.size()};
+        }
+        
+        Training toTraining(size_t row) const {
+            return segmentView(row >> SEGMENT_SHIFT).toTraining(row & (SEGMENT_ROWS - 1));
+        }
+        
+    private:
+        const SegmentedTrainingStore* store;
+        size_t slot;
+        size_t rowCount;
+        const Directory* directory;
+    };
+    
+    explicit SegmentedTrainingStore(std::vector<std::string> names)
+        : trainerNames(std::move(names)), directory(new Directory) {}
+    
+    ~SegmentedTrainingStore() {
+        delete directory.load();
+        for (const Segment* seg : ownedSegments) {
+            delete seg;
+        }
+    }
+    
+    SegmentedTrainingStore(const SegmentedTrainingStore&) = delete;
+    SegmentedTrainingStore& operator=(const SegmentedTrainingStore&) = delete;
+    
+    // Appends rows of `batch` (trainer ids must index this store's
+    // dictionary) and publishes them atomically
+    void append(const TrainingColumnsView& batch) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        size_t row = publishedRows.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < batch.size(); ++i, ++row) {
+            size_t offset = row & (SEGMENT_ROWS - 1);
+            if (offset == 0) {
+                addSegment();
+            }
+            Segment* seg = ownedSegments.back();
+            seg->days[offset] = batch.days[i];
+            seg->minutes[offset] = batch.minutes[i];
+            seg->trainers[offset] = batch.trainers[i];
+        }
+        publishedRows.store(row, std::memory_order_release);
+    }
+    
+    size_t size() const { return publishedRows.load(std::memory_order_acquire); }
+    size_t reclaimedDirectories() const { return epochs.reclaimedCount(); }
+    
+private:
+    std::vector<std::string> trainerNames;
+    std::atomic<const Directory*> directory;
+    std::atomic<size_t> publishedRows{0};
+    std::mutex writerMutex;  // serializes writers only, readers never take it
+    std::vector<Segment*> ownedSegments;
+    mutable EpochReclaimer<Directory> epochs;
+    
+    void addSegment() {
+        ownedSegments.push_back(new Segment);
+        const Directory* old = directory.load();
+        Directory* next = new Directory(*old);
+        next->segments.push_back(ownedSegments.back());
+        directory.store(next);
+        epochs.retire(old);
+    }
+};
+
+// Query over a snapshot; row ids are global store positions
+template<TrainingPredicate Pred>
+std::vector<size_t> findTrainings(const SegmentedTrainingStore::Snapshot& snapshot,
+                                  const Pred& pred, int numThreads) {
+    validatePredicate(pred);
+    std::vector<TrainingColumnsView> views(snapshot.segmentCount());
+    for (size_t s = 0; s < views.size(); ++s) {
+        views[s] = snapshot.segmentView(s);
+    }
+    constexpr size_t shift = SegmentedTrainingStore::SEGMENT_SHIFT;
+    constexpr size_t mask = SegmentedTrainingStore::SEGMENT_ROWS - 1;
+    
+    std::vector<size_t> result;
+    countThenScatter(snapshot.size(), numThreads,
+        [&](size_t k) { return pred(views[k >> shift], k & mask); },
+        [&](size_t total) { result.resize(total); },
+        [&](size_t out, size_t k) { result[out] = k; });
+    return result;
+}
+
+// ==================== Query Result Cache ====================
+
+// Results of runtime queries keyed by canonical query text. Each entry
+// remembers the dataset version it was computed for and is recomputed once
+// the version moves. Concurrent callers asking for the same entry share one
+// computation and one read-only result; least recently used entries are
+// evicted to stay within the memory budget.
+class QueryResultCache {
+public:
+    using Rows = std::shared_ptr<const std::vector<RowId>>;
+    
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t staleMisses = 0;  // entry present but for an older version
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+    
+    explicit QueryResultCache(size_t memoryBudgetBytes) : budget(memoryBudgetBytes) {}
+    
+    // compute() runs outside the cache lock and must return the result of
+    // `spec` on the dataset at `datasetVersion`
+    template<typename Compute>
+    Rows getOrCompute(const QuerySpec& spec, uint64_t datasetVersion, Compute compute) {
+        spec.requireNormalized();
+        std::string key = spec.toString();
+        std::unique_lock<std::mutex> lock(cacheMutex);
+        
+        auto it = index.find(key);
+        if (it != index.end()) {
+            if (it->second->version == datasetVersion) {
+                ++counters.hits;
+                lru.splice(lru.begin(), lru, it->second);
+                std::shared_future<Rows> pending = it->second->result;
+                lock.unlock();
+                return pending.get();
+            }
+            ++counters.staleMisses;
+            erase(it->second);
+        }
+        ++counters.misses;
+        
+        std::promise<Rows> promise;
+        lru.push_front({key, datasetVersion, promise.get_future().share(), 0});
+        index[key] = lru.begin();
+        lock.unlock();
+        
+        Rows rows;
+        try {
+            rows = std::make_shared<const std::vector<RowId>>(compute());
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+            lock.lock();
+            auto failed = index.find(key);
+            if (failed != index.end() && failed->second->version == datasetVersion) {
+                erase(failed->second);
+            }
+            throw;
+        }
+        promise.set_value(rows);
+        
+        lock.lock();
+        auto done = index.find(key);
+        if (done != index.end() && done->second->version == datasetVersion) {
+            done->second->bytes = rows->capacity() * sizeof(RowId) + key.size() + sizeof(Entry);
+            usedBytes += done->second->bytes;
+            evictToBudget();
+        }
+        return rows;
+    }
+    
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        Stats s = counters;
+        s.entries = lru.size();
+        s.bytes = usedBytes;
+        return s;
+    }
+    
+private:
+    struct Entry {
+        std::string key;
+        uint64_t version;
+        std::shared_future<Rows> result;
+        size_t bytes;  // 0 while the result is being computed
+    };
+    
+    size_t budget;
+    size_t usedBytes = 0;
+    std::list<Entry> lru;  // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    Stats counters;
+    mutable std::mutex cacheMutex;
+    
+    void erase(std::list<Entry>::iterator entry) {
+        usedBytes -= entry->bytes;
+        index.erase(entry->key);
+        lru.erase(entry);
+    }
+    
+    // Entries still being computed have no size yet and are skipped
+    void evictToBudget() {
+        auto it = lru.end();
+        while (usedBytes > budget && it != lru.begin()) {
+            --it;
+            if (it->bytes == 0) continue;
+            auto victim = it++;
+            erase(victim);
+            ++counters.evictions;
+        }
+    }
+};
+
+// ==================== Query Server ====================
+//
+// Line protocol, one request per line:
+//   <query>            e.g. "weekday=1 time=08:00..11:59 order=date limit=5"
+//   TRAINERS           dictionary ids and names
+//   QUIT               close the connection
+//   SHUTDOWN           stop the server
+// Query fields: weekday=<d,...> date=<yyyy-mm-dd>..<yyyy-mm-dd> (either end
+// may be empty) time=<hh:mm>..<hh:mm> trainer=<id,...> order=<date|time|
+// trainer>[-desc] limit=<n>. An empty query matches everything.
+// Reply: "OK <matches>", then up to `limit` lines "ROW <training>", then
+// "END"; errors are a single "ERR <message>" line.
+
+struct ServerRequest {
+    QuerySpec spec;
+    bool ordered = false;
+    QueryOrder order;
+};
+
+int parseIntField(const std::string& text) {
+    size_t used = 0;
+    int value = std::stoi(text, &used);
+    if (used != text.size()) {
+        throw std::invalid_argument("не число: " + text);
+    }
+    return value;
+}
+
+std::vector<int> parseIntList(const std::string& text) {
+    std::vector<int> values;
+    std::istringstream iss(text);
+    for (std::string item; std::getline(iss, item, ',');) {
+        values.push_back(parseIntField(item));
+    }
+    return values;
+}
+
+int32_t parseIsoDate(const std::string& text) {
+    Date d;
+    const char* p = text.data();
+    const char* end = p + text.size();
+    if (!parseDigits(p, end, 4, d.year) || !expectChar(p, end, '-') ||
+        !parseDigits(p, end, 2, d.month) || !expectChar(p, end, '-') ||
+        !parseDigits(p, end, 2, d.day) || p != end || !d.isValid()) {
+        throw std::invalid_argument("неверная дата: " + text);
+    }
+    return d.toDays();
+}
+
+uint16_t parseClock(const std::string& text) {
+    int h, m;
+    const char* p = text.data();
+    const char* end = p + text.size();
+    if (!parseDigits(p, end, 2, h) || !expectChar(p, end, ':') || !parseDigits(p, end, 2, m) ||
+        p != end || h > 23 || m > 59) {
+        throw std::invalid_argument("неверное время: " + text);
+    }
+    return static_cast<uint16_t>(h * 60 + m);
+}
+
+// Splits "a..b" into its two (possibly empty) ends
+std::pair<std::string, std::string> splitRange(const std::string& text) {
+    size_t dots = text.find("..");
+    if (dots == std::string::npos) {
+        return {text, text};
+    }
+    return {text.substr(0, dots), text.substr(dots + 2)};
+}
+
+ServerRequest parseServerRequest(const std::string& line, size_t trainerCount) {
+    ServerRequest request;
+    QuerySpec& spec = request.spec;
+    std::istringstream iss(line);
+    for (std::string token; iss >> token;) {
+        size_t eq = token.find('=');
+        if (eq == std::string::npos) {
+            throw std::invalid_argument("ожидалось поле=значение: " + token);
+        }
+        std::string field = token.substr(0, eq);
+        std::string value = token.substr(eq + 1);
+        
+        if (field == "weekday") {
+            spec.weekdayMask = 0;
+            for (int d : parseIntList(value)) {
+                if (d < 0 || d > 6) throw std::invalid_argument("день недели вне 0-6");
+                spec.weekdayMask |= static_cast<uint8_t>(1u << d);
+            }
+        } else if (field == "date") {
+            auto [from, to] = splitRange(value);
+            if (!from.empty()) spec.fromDays = parseIsoDate(from);
+            if (!to.empty()) spec.toDays = parseIsoDate(to);
+        } else if (field == "time") {
+            auto [from, to] = splitRange(value);
+            if (!from.empty()) spec.fromMinutes = parseClock(from);
+            if (!to.empty()) spec.toMinutes = parseClock(to);
+        } else if (field == "trainer") {
+            for (int id : parseIntList(value)) {
+                if (id < 0 || static_cast<size_t>(id) >= trainerCount) {
+                    throw std::invalid_argument("нет тренера с номером " + std::to_string(id));
+                }
+                spec.trainerIds.push_back(static_cast<uint16_t>(id));
+            }
+        } else if (field == "order") {
+            request.ordered = true;
+            request.order.descending = value.size() > 5 && value.compare(value.size() - 5, 5, "-desc") == 0;
+            std::string key = request.order.descending ? value.substr(0, value.size() - 5) : value;
+            if (key == "date") request.order.key = OrderBy::Date;
+            else if (key == "time") request.order.key = OrderBy::Time;
+            else if (key == "trainer") request.order.key = OrderBy::Trainer;
+            else throw std::invalid_argument("неизвестный порядок: " + value);
+        } else if (field == "limit") {
+            int limit = parseIntField(value);
+            if (limit < 0) throw std::invalid_argument("отрицательный limit");
+            request.order.limit = static_cast<size_t>(limit);
+        } else {
+            throw std::invalid_argument("неизвестное поле: " + field);
+        }
+    }
+    spec.normalize();
+    return request;
+}
+
+// Coalesces queries that arrive within `window` of the first pending one
+// into a single shared scan (runQueryBatch)
+class QueryBatcher {
+public:
+    QueryBatcher(const TrainingColumnsView& v, int threads, std::chrono::microseconds window)
+        : view(v), numThreads(threads), batchWindow(window), worker([this]() { run(); }) {}
+    
+    ~QueryBatcher() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueCv.notify_one();
+        worker.join();
+    }
+    
+    std::future<std::vector<RowId>> submit(const QuerySpec& spec) {
+        spec.requireNormalized();
+        std::lock_guard<std::mutex> lock(queueMutex);
+        pending.push_back({spec, {}});
+        auto future = pending.back().promise.get_future();
+        queueCv.notify_one();
+        return future;
+    }
+    
+    uint64_t batchCount() const { return batches.load(); }
+    uint64_t queryCount() const { return queries.load(); }
+    
+private:
+    struct Pending {
+        QuerySpec spec;
+        std::promise<std::vector<RowId>> promise;
+    };
+    
+    const TrainingColumnsView& view;
+    int numThreads;
+    std::chrono::microseconds batchWindow;
+    std::mutex queueMutex;
+    std::condition_variable queueCv;
+    std::vector<Pending> pending;
+    bool stopping = false;
+    std::atomic<uint64_t> batches{0};
+    std::atomic<uint64_t> queries{0};
+    std::thread worker;  // last member: started after everything above exists
+    
+    void run() {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        for (;;) {
+            queueCv.wait(lock, [&]() { return stopping || !pending.empty(); });
+            if (pending.empty()) {
+                return;
+            }
+            // Let more queries join the batch
+            queueCv.wait_for(lock, batchWindow, [&]() { return stopping; });
+            std::vector<Pending> batch;
+            batch.swap(pending);
+            lock.unlock();
+            
+            std::vector<QuerySpec> specs;
+            for (const auto& p : batch) specs.push_back(p.spec);
+            std::vector<std::vector<RowId>> results = runQueryBatch(view, specs, numThreads);
+            for (size_t q = 0; q < batch.size(); ++q) {
+                batch[q].promise.set_value(std::move(results[q]));
+            }
+            batches.fetch_add(1);
+            queries.fetch_add(batch.size());
+            
+            lock.lock();
+        }
+    }
+};
+
+bool writeAll(int fd, const std::string& data) {
+    const char* p = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+        ssize_t written = ::write(fd, p, left);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += written;
+        left -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Buffered line reader over a file descriptor
+class LineReader {
+public:
+    explicit LineReader(int f) : fd(f) {}
+    
+    bool readLine(std::string& line) {
+        for (;;) {
+            size_t nl = buffer.find('\n', scanned);
+            if (nl != std::string::npos) {
+                line.assign(buffer, 0, nl);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                buffer.erase(0, nl + 1);
+                scanned = 0;
+                return true;
+            }
+            scanned = buffer.size();
+            char chunk[4096];
+            ssize_t got = ::read(fd, chunk, sizeof(chunk));
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) {
+                if (buffer.empty()) return false;
+                line.swap(buffer);
+                buffer.clear();
+                scanned = 0;
+                return true;
+            }
+            buffer.append(chunk, static_cast<size_t>(got));
+        }
+    }
+    
+private:
+    int fd;
+    std::string buffer;
+    size_t scanned = 0;
+};
+
+class TrainingQueryServer {
+public:
+    TrainingQueryServer(const TrainingColumnsView& v, int threads,
+                        std::chrono::microseconds window, size_t cacheBytes)
+        : view(v), numThreads(threads), batcher(v, threads, window), cache(cacheBytes) {}
+    
+    // Answers requests from `in` on `out` until QUIT, SHUTDOWN or EOF
+    void serveConnection(int in, int out) {
+        LineReader reader(in);
+        for (std::string line; !shuttingDown.load() && reader.readLine(line);) {
+            if (line == "QUIT") break;
+            if (line == "SHUTDOWN") {
+                shutdown();
+                break;
+            }
+            if (!writeAll(out, handle(line))) break;
+        }
+    }
+    
+    // Accepts connections on a Unix domain socket, one detached thread per
+    // client; clientFds doubles as the count of live connections, so
+    // finished ones leave nothing behind
+    void serveSocket(const std::string& path) {
+        listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (listenFd < 0 || path.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error("Не удалось создать сокет " + path);
+        }
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        ::unlink(path.c_str());
+        if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listenFd, 128) != 0) {
+            ::close(listenFd);
+            throw std::runtime_error("Не удалось слушать " + path + ": " + std::strerror(errno));
+        }
+        
+        while (!shuttingDown.load()) {
+            int fd = ::accept(listenFd, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(clientsMutex);
+                clientFds.push_back(fd);
+            }
+            std::thread([this, fd]() {
+                serveConnection(fd, fd);
+                std::lock_guard<std::mutex> lock(clientsMutex);
+                clientFds.erase(std::find(clientFds.begin(), clientFds.end(), fd));
+                ::close(fd);
+                clientsDone.notify_all();
+            }).detach();
+        }
+        {
+            std::unique_lock<std::mutex> lock(clientsMutex);
+            clientsDone.wait(lock, [this]() { return clientFds.empty(); });
+        }
+        ::close(listenFd);
+        ::unlink(path.c_str());
+    }
+    
+    // Unblocks accept() and every connection still waiting for a request
+    void shutdown() {
+        shuttingDown.store(true);
+        if (listenFd >= 0) {
+            ::shutdown(listenFd, SHUT_RDWR);
+        }
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        for (int fd : clientFds) {
+            ::shutdown(fd, SHUT_RD);
+        }
+    }
+    
+    std::string statistics() const {
+        QueryResultCache::Stats c = cache.stats();
+        std::ostringstream oss;
+        uint64_t batches = batcher.batchCount();
+        oss << "Пакетов: " << batches << ", запросов в пакетах: " << batcher.queryCount()
+            << " (в среднем " << std::fixed << std::setprecision(2)
+            << static_cast<double>(batcher.queryCount()) / std::max<uint64_t>(1, batches)
+            << "), попаданий в кэш: " << c.hits << ", промахов: " << c.misses;
+        return oss.str();
+    }
+    
+private:
+    const TrainingColumnsView& view;
+    int numThreads;
+    QueryBatcher batcher;
+    QueryResultCache cache;
+    std::atomic<bool> shuttingDown{false};
+    int listenFd = -1;
+    std::mutex clientsMutex;
+    std::condition_variable clientsDone;
+    std::vector<int> clientFds;
+    
+    std::string handle(const std::string& line) {
+        std::ostringstream reply;
+        if (line == "TRAINERS") {
+            reply << "OK " << view.trainerCount << "\n";
+            for (size_t id = 0; id < view.trainerCount; ++id) {
+                reply << "ROW " << id << " " << view.trainerNames[id] << "\n";
+            }
+            reply << "END\n";
+            return reply.str();
+        }
+        
+        ServerRequest request;
+        try {
+            request = parseServerRequest(line, view.trainerCount);
+        } catch (const std::exception& e) {
+            return std::string("ERR ") + e.what() + "\n";
+        }
+        
+        // The dataset is loaded once and never changes: version 0
+        QueryResultCache::Rows rows = cache.getOrCompute(request.spec, 0,
+            [&]() { return batcher.submit(request.spec).get(); });
+        
+        // Ordered replies list every match unless limited; unordered ones
+        // list only `limit` rows
+        std::vector<RowId> shown;
+        if (request.ordered) {
+            shown = orderRows(view, *rows, request.order, numThreads);
+        } else {
+            size_t keep = std::min(request.order.limit, rows->size());
+            shown.assign(rows->begin(), rows->begin() + keep);
+        }
+        
+        reply << "OK " << rows->size() << "\n";
+        for (RowId row : shown) {
+            reply << "ROW " << view.toTraining(row).toString() << "\n";
+        }
+        reply << "END\n";
+        return reply.str();
+    }
+};
+
+int connectUnixSocket(const std::string& path) {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error("Не удалось подключиться к " + path + ": " + std::strerror(errno));
+    }
+    return fd;
+}
+
+struct LoadReport {
+    std::vector<double> latenciesUs;  // sorted
+    double seconds = 0;
+    uint64_t errors = 0;
+};
+
+// Closed-loop load generator: every connection sends its next query as soon
+// as the previous reply has been read
+LoadReport runLoadGenerator(const std::string& path, int connections, int requestsPerConnection) {
+    std::vector<std::vector<double>> latencies(connections);
+    std::atomic<uint64_t> errors{0};
+    std::vector<std::thread> threads;
+    
+    // Connect up front so a missing server is reported instead of thrown
+    // out of a worker thread
+    std::vector<int> fds;
+    try {
+        for (int c = 0; c < connections; ++c) fds.push_back(connectUnixSocket(path));
+    } catch (...) {
+        for (int fd : fds) ::close(fd);
+        throw;
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < connections; ++c) {
+        threads.emplace_back([&, c]() {
+            int fd = fds[c];
+            LineReader reader(fd);
+            for (int r = 0; r < requestsPerConnection; ++r) {
+                uint64_t h = splitMix64(uint64_t(c) << 32 | uint64_t(r));
+                std::ostringstream query;
+                query << "weekday=" << h % 7;
+                if ((h >> 8) % 2) query << " time=" << std::setfill('0') << std::setw(2) << 8 + (h >> 12) % 10 << ":00..";
+                if ((h >> 16) % 4 == 0) query << " trainer=" << (h >> 20) % 12;
+                if ((h >> 24) % 2) query << " order=date limit=5";
+                query << "\n";
+                
+                auto sent = std::chrono::steady_clock::now();
+                std::string line;
+                bool ok = writeAll(fd, query.str()) && reader.readLine(line) && line.rfind("OK", 0) == 0;
+                while (ok && reader.readLine(line) && line != "END") {}
+                latencies[c].push_back(std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - sent).count());
+                if (!ok) errors.fetch_add(1);
+            }
+            writeAll(fd, "QUIT\n");
+            ::close(fd);
+        });
+    }
+    for (auto& t : threads) t.join();
+    
+    LoadReport report;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const auto& l : latencies) {
+        report.latenciesUs.insert(report.latenciesUs.end(), l.begin(), l.end());
+    }
+    std::sort(report.latenciesUs.begin(), report.latenciesUs.end());
+    report.errors = errors.load();
+    return report;
+}
+
+// ==================== Benchmarking ====================
+
+// Microseconds with sub-microsecond resolution from a monotonic clock
+template<typename Func>
+double measureTime(Func func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+// Exact contents of a result set: every record packed as (days, minutes,
+// trainer) and sorted, so equal record multisets compare equal regardless
+// of layout, row ids or output order. Trainers are compared by name via a
+// shared dictionary, since row and column layouts number them differently
+struct ResultContents {
+    std::vector<uint64_t> records;
+    
+    static uint16_t trainerId(const std::string& name) {
+        static std::unordered_map<std::string, uint16_t> ids;
+        return ids.emplace(name, static_cast<uint16_t>(ids.size())).first->second;
+    }
+    
+    void add(int days, int minutes, uint16_t trainer) {
+        records.push_back(uint64_t(uint32_t(days) ^ 0x80000000u) << 32 |
+                          uint64_t(uint16_t(minutes)) << 16 | trainer);
+    }
+    
+    size_t count() const { return records.size(); }
+    bool operator==(const ResultContents& other) const { return records == other.records; }
+};
+
+ResultContents contentsOf(const std::vector<Training>& trainings) {
+    ResultContents c;
+    c.records.reserve(trainings.size());
+    for (const auto& t : trainings) {
+        c.add(t.date.toDays(), t.time.hours * 60 + t.time.minutes,
+              ResultContents::trainerId(t.trainerName));
+    }
+    std::sort(c.records.begin(), c.records.end());
+    return c;
+}
+
+template<typename Rows>
+ResultContents contentsOf(const TrainingColumnsView& view, const Rows& rows) {
+    std::vector<uint16_t> ids(view.trainerCount);
+    for (size_t i = 0; i < view.trainerCount; ++i) {
+        ids[i] = ResultContents::trainerId(view.trainerNames[i]);
+    }
+    ResultContents c;
+    c.records.reserve(std::size(rows));
+    for (auto row : rows) {
+        c.add(view.days[row], view.minutes[row], ids[view.trainers[row]]);
+    }
+    std::sort(c.records.begin(), c.records.end());
+    return c;
+}
+
+struct BenchRecord {
+    std::string strategy;
+    std::string query;
+    size_t size = 0;
+    int threads = 0;
+    size_t matches = 0;
+    double bytesPerRecord = 0;
+    std::vector<double> timesUs;  // sorted ascending
+    bool correct = false;
+    size_t scanned = 0;           // records actually read, fewer than size when blocks are skipped
+    
+    double percentile(double p) const {
+        size_t rank = static_cast<size_t>(p / 100.0 * (timesUs.size() - 1) + 0.5);
+        return timesUs[std::min(rank, timesUs.size() - 1)];
+    }
+    double recordsPerSecond() const { return size / (percentile(50) / 1e6); }
+    double gigabytesPerSecond() const { return scanned * bytesPerRecord / (percentile(50) / 1e6) / 1e9; }
+};
+
+// One warm-up run plus `repeats` timed runs; the last result is checked
+// record for record against the reference
+template<typename Run, typename Contents>
+BenchRecord timeStrategy(const std::string& strategy, const std::string& query, size_t size,
+                         int threads, int repeats, double bytesPerRecord,
+                         const ResultContents& reference, Run run, Contents contents) {
+    BenchRecord record{strategy, query, size, threads, 0, bytesPerRecord, {}, false, size};
+    auto result = run();
+    for (int r = 0; r < repeats; ++r) {
+        record.timesUs.push_back(measureTime([&]() { result = run(); }));
+    }
+    std::sort(record.timesUs.begin(), record.timesUs.end());
+    ResultContents c = contents(result);
+    record.matches = c.count();
+    record.correct = c == reference;
+    return record;
+}
+
+void printBenchRecord(const BenchRecord& r) {
+    std::cout << std::left << std::setw(12) << r.strategy << std::setw(14) << r.query << std::right
+              << std::setw(11) << r.size << std::setw(4) << r.threads
+              << std::setw(7) << std::fixed << std::setprecision(2)
+              << 100.0 * r.matches / std::max<size_t>(1, r.size) << "%"
+              << std::setw(11) << std::setprecision(3) << r.percentile(50) / 1000
+              << std::setw(11) << r.percentile(90) / 1000
+              << std::setw(10) << std::setprecision(1) << r.recordsPerSecond() / 1e6
+              << std::setw(8) << std::setprecision(2) << r.gigabytesPerSecond()
+              << "  " << (r.correct ? "ok" : "MISMATCH") << "\n";
+}
+
+void writeBenchJson(const std::string& path, const std::vector<BenchRecord>& records, int repeats) {
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("Не удалось создать " + path);
+    }
+    out << std::setprecision(6) << "{\n  \"benchmark\": \"trainings\",\n"
+        << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+        << "  \"repeats\": " << repeats << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < records.size(); ++i) {
+        const BenchRecord& r = records[i];
+        out << "    {\"strategy\": \"" << r.strategy << "\", \"query\": \"" << r.query
+            << "\", \"size\": " << r.size << ", \"threads\": " << r.threads
+            << ", \"matches\": " << r.matches
+            << ", \"selectivity\": " << static_cast<double>(r.matches) / std::max<size_t>(1, r.size)
+            << ", \"min_ms\": " << r.timesUs.front() / 1000
+            << ", \"p50_ms\": " << r.percentile(50) / 1000
+            << ", \"p90_ms\": " << r.percentile(90) / 1000
+            << ", \"p99_ms\": " << r.percentile(99) / 1000
+            << ", \"max_ms\": " << r.timesUs.back() / 1000
+            << ", \"records_scanned\": " << r.scanned
+            << ", \"records_per_sec\": " << r.recordsPerSecond()
+            << ", \"gb_per_sec\": " << r.gigabytesPerSecond()
+            << ", \"correct\": " << (r.correct ? "true" : "false") << "}"
+            << (i + 1 < records.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+// The default sweep stops at 10M records to stay within a laptop's memory;
+// pass 100000000 as the size argument for the full 100M sweep
+struct BenchConfig {
+    size_t maxSize = 10000000;
+    int maxThreads = 8;
+    int repeats = 5;
+    std::string jsonPath;
+};
+
+// Every columnar strategy for one query, references come from one thread
+template<TrainingPredicate Pred>
+void benchColumnarQuery(const std::string& query, const Pred& pred, const TrainingColumnsView& flat,
+                        const BlockedTrainings& blocked, const std::vector<int>& threadCounts,
+                        const BenchConfig& config, std::vector<BenchRecord>& records) {
+    const double columnBytes = sizeof(int32_t) + 2 * sizeof(uint16_t);
+    ResultContents reference = contentsOf(flat, findTrainings(flat, pred, 1));
+    auto flatContents = [&](const std::vector<RowId>& rows) { return contentsOf(flat, rows); };
+    auto blockedContents = [&](const PrunedScanResult& r) { return contentsOf(blocked.view(), r.rows); };
+    
+    // Zone maps skip blocks, so their GB/s counts only the blocks read
+    size_t scannedRows = 0;
+    for (size_t b = 0; b < blocked.blockCount(); ++b) {
+        if (pred.mayMatch(blocked.zone(b))) scannedRows += blocked.blockEnd(b) - blocked.blockBegin(b);
+    }
+    
+    for (int threads : threadCounts) {
+        records.push_back(timeStrategy("columnar", query, flat.size(), threads, config.repeats,
+            columnBytes, reference, [&]() { return findTrainings(flat, pred, threads); }, flatContents));
+        printBenchRecord(records.back());
+        records.push_back(timeStrategy("zonemap", query, flat.size(), threads, config.repeats,
+            columnBytes, reference, [&]() { return findTrainingsPruned(blocked, pred, threads); },
+            blockedContents));
+        records.back().scanned = scannedRows;
+        printBenchRecord(records.back());
+    }
+}
+
+// Sweeps data size (10K .. maxSize, x10), thread count (1 .. maxThreads,
+// x2) and query selectivity for every query strategy
+std::vector<BenchRecord> runBenchmarkSuite(const BenchConfig& config) {
+    std::vector<BenchRecord> records;
+    std::vector<int> threadCounts;
+    for (int t = 1; t <= config.maxThreads; t *= 2) {
+        threadCounts.push_back(t);
+    }
+    
+    std::cout << std::left << std::setw(12) << "strategy" << std::setw(14) << "query" << std::right
+              << std::setw(11) << "size" << std::setw(4) << "thr" << std::setw(8) << "sel"
+              << std::setw(11) << "p50 ms" << std::setw(11) << "p90 ms"
+              << std::setw(10) << "Mrec/s" << std::setw(8) << "GB/s" << "\n";
+    
+    for (size_t size = 10000; size <= config.maxSize; size *= 10) {
+        TrainingColumns columns = generateTrainingColumns(size, config.maxThreads);
+        TrainingColumnsView flat = columns.view();
+        BlockedTrainings blocked(flat, config.maxThreads);
+        
+        // Row-oriented strategies only answer weekday queries and keep one
+        // heap string per record, so they stop at 10M records
+        if (size <= 10000000) {
+            std::vector<Training> trainings = generateTrainingsParallel(size, config.maxThreads);
+            ResultContents reference = contentsOf(findTrainingsByDaySingleThread(trainings, 1));
+            auto contents = [](const std::vector<Training>& r) { return contentsOf(r); };
+            const double rowBytes = sizeof(Training);
+            
+            records.push_back(timeStrategy("single", "weekday", size, 1, config.repeats, rowBytes,
+                reference, [&]() { return findTrainingsByDaySingleThread(trainings, 1); }, contents));
+            printBenchRecord(records.back());
+            for (int threads : threadCounts) {
+                records.push_back(timeStrategy("mutex", "weekday", size, threads, config.repeats, rowBytes,
+                    reference, [&]() { return findTrainingsByDayMultiThreadMutex(trainings, 1, threads); }, contents));
+                printBenchRecord(records.back());
+                records.push_back(timeStrategy("scatter", "weekday", size, threads, config.repeats, rowBytes,
+                    reference, [&]() { return findTrainingsByDayScatter(trainings, 1, threads); }, contents));
+                printBenchRecord(records.back());
+            }
+        }
+        
+        // Selectivity from ~86% down to ~0.1%
+        benchColumnarQuery("not-sunday", !WeekdayIs(0), flat, blocked, threadCounts, config, records);
+        benchColumnarQuery("weekday", WeekdayIs(1), flat, blocked, threadCounts, config, records);
+        benchColumnarQuery("trainer", TrainerSet(flat, {"Иванов И.И."}), flat, blocked,
+                           threadCounts, config, records);
+        benchColumnarQuery("month", DateRange({1, 3, 2024}, {31, 3, 2024}), flat, blocked,
+                           threadCounts, config, records);
+        benchColumnarQuery("week-morning", DateRange({10, 6, 2024}, {16, 6, 2024}) &&
+                           TimeRange({8, 0}, {9, 59}), flat, blocked, threadCounts, config, records);
+    }
+    
+    if (!config.jsonPath.empty()) {
+        writeBenchJson(config.jsonPath, records, config.repeats);
+        std::cout << "\nJSON: " << config.jsonPath << "\n";
+    }
+    return records;
+}
+
+// ==================== Command-line Modes ====================
+
+void printUsage(const char* program) {
+    std::cout << "\nИспользование:\n"
+              << "  " << program << " <размер_данных> <кол-во_потоков> <день_недели>\n"
+              << "  " << program << " --make-csv <файл.csv> <кол-во_записей>\n"
+              << "  " << program << " --import <файл.csv> <файл.bin> [потоки]\n"
+              << "  " << program << " --query <файл.bin> <день_недели> [потоки]\n"
+              << "  " << program << " --queries <размер_данных> [потоки]\n"
+              << "  " << program << " --generate <размер_данных> [потоки]\n"
+              << "  " << program << " --aggregate <размер_данных> [потоки]\n"
+              << "  " << program << " --zonemap <размер_данных> [потоки]\n"
+              << "  " << program << " --ingest <начальный_размер> <записей/с> <секунд> [читатели]\n"
+              << "  " << program << " --bench [макс_размер] [макс_потоков] [повторы] [результат.json]\n"
+              << "      (по умолчанию до 10000000 записей; 100000000 — полный прогон,\n"
+              << "       строковые стратегии ограничены 10000000)\n"
+              << "  " << program << " --ordered <размер_данных> [потоки]\n"
+              << "  " << program << " --cache <размер_данных> [потоки] [бюджет_МБ]\n"
+              << "  " << program << " --server <сокет|-> <размер_данных|файл.bin> [потоки] [окно_мкс]\n"
+              << "  " << program << " --client <сокет> [соединений] [запросов_на_соединение]\n"
+              << "  " << program << " --partition <размер_данных> [потоки]\n";
+}
+
+int runMakeCsv(const std::string& path, size_t count) {
+    std::vector<Training> trainings = generateTrainingsParallel(count, 4);
+    writeTrainingsCsv(path, trainings);
+    std::cout << "Записано " << trainings.size() << " строк в " << path << "\n";
+    return 0;
+}
+
+int runImport(const std::string& csvPath, const std::string& binPath, int numThreads) {
+    CsvImportStats stats;
+    double importTime = measureTime([&]() {
+        stats = importCsvToTrainingFile(csvPath, binPath, numThreads);
+    });
+    
+    std::cout << "Импортировано записей: " << stats.records << "\n";
+    std::cout << "Пропущено строк: " << stats.skippedLines << "\n";
+    std::cout << "Тренеров в словаре: " << stats.trainers << "\n";
+    std::cout << "Время импорта: " << std::fixed << std::setprecision(2) << importTime / 1000
+              << " мс (" << std::setprecision(1)
+              << stats.bytesRead / (importTime / 1e6) / (1 << 20) << " МБ/с)\n";
+    return 0;
+}
+
+int runQueryFile(const std::string& binPath, int targetDay, int numThreads) {
+    MappedTrainingFile file(binPath);
+    const TrainingColumnsView& view = file.view();
+    std::cout << "Записей в файле: " << view.size() << ", тренеров: " << view.trainerCount << "\n";
+    
+    std::vector<RowId> rows;
+    double queryTime = measureTime([&]() {
+        rows = findTrainingsByDayColumns(view, targetDay, numThreads);
+    });
+    
+    std::cout << "Тренировки в " << DAY_NAMES[targetDay] << ": " << rows.size() << "\n";
+    std::cout << "Время выполнения: " << std::fixed << std::setprecision(2)
+              << queryTime / 1000 << " мс\n\n";
+    
+    size_t displayCount = std::min(rows.size(), size_t(10));
+    for (size_t i = 0; i < displayCount; ++i) {
+        std::cout << std::setw(3) << (i + 1) << ". " << view.toTraining(rows[i]).toString() << "\n";
+    }
+    return 0;
+}
+
+// Compares one scan per query against a single batched scan
+int runQueriesDemo(size_t dataSize, int numThreads) {
+    TrainingColumns columns = generateTrainingColumns(dataSize, numThreads);
+    TrainingColumnsView view = columns.view();
+    
+    auto mondayMorning = WeekdayIs(1) && TimeRange({8, 0}, {11, 59});
+    auto summer2024 = DateRange({1, 6, 2024}, {31, 8, 2024}) && !WeekdayIs(0);
+    auto twoTrainers = TrainerSet(view, {"Иванов И.И.", "Петров П.П.", "Павлов П.А."}) ||
+                       (WeekdayIs(6) && TimeRange({20, 0}, {23, 59}));
+    const char* names[] = {"пн 08:00-11:59", "лето 2024 без вс", "тренеры или сб вечер"};
+    
+    std::array<std::vector<RowId>, 3> separate;
+    double separateTime = measureTime([&]() {
+        separate[0] = findTrainings(view, mondayMorning, numThreads);
+        separate[1] = findTrainings(view, summer2024, numThreads);
+        separate[2] = findTrainings(view, twoTrainers, numThreads);
+    });
+    
+    std::array<std::vector<RowId>, 3> batched;
+    double batchTime = measureTime([&]() {
+        batched = runQueries(view, numThreads, mondayMorning, summer2024, twoTrainers);
+    });
+    
+    std::vector<WeekdayIs> days;
+    for (int d = 0; d < 7; ++d) days.emplace_back(d);
+    std::vector<std::vector<RowId>> weekly;
+    double weeklyTime = measureTime([&]() {
+        weekly = runQueryBatch(view, days, numThreads);
+    });
+    
+    std::cout << "Записей: " << view.size() << ", потоков: " << numThreads << "\n\n";
+    for (size_t q = 0; q < batched.size(); ++q) {
+        std::cout << "  " << names[q] << ": " << batched[q].size() << "\n";
+    }
+    size_t weeklyTotal = 0;
+    for (const auto& rows : weekly) weeklyTotal += rows.size();
+    
+    std::cout << std::fixed << std::setprecision(3)
+              << "\nОтдельные сканирования: " << separateTime / 1000 << " мс\n"
+              << "Один пакетный проход:   " << batchTime / 1000 << " мс\n"
+              << "7 дней недели за проход: " << weeklyTime / 1000 << " мс ("
+              << weeklyTotal << " записей)\n";
+    
+    bool match = separate == batched && weeklyTotal == view.size();
+    std::cout << "Результаты совпадают: " << (match ? "✓ ДА" : "✗ НЕТ") << "\n";
+    return match ? 0 : 1;
+}
+
+// FNV-1a over the column bytes, used to check that generation is deterministic
+uint64_t hashColumns(const TrainingColumns& columns) {
+    uint64_t h = 1469598103934665603ULL;
+    auto mix = [&](const void* data, size_t bytes) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < bytes; ++i) {
+            h = (h ^ p[i]) * 1099511628211ULL;
+        }
+    };
+    mix(columns.days.data(), columns.days.size() * sizeof(int32_t));
+    mix(columns.minutes.data(), columns.minutes.size() * sizeof(uint16_t));
+    mix(columns.trainers.data(), columns.trainers.size() * sizeof(uint16_t));
+    return h;
+}
+
+int runGenerateDemo(size_t dataSize, int numThreads) {
+    std::cout << "Записей: " << dataSize << ", потоков: " << numThreads << "\n\n" << std::fixed << std::setprecision(2);
+    
+    // The sequential reference builds a string per record; skip it where it
+    // would not fit in memory
+    if (dataSize <= 20000000) {
+        double seqTime = measureTime([&]() { generateTrainings(dataSize); });
+        std::cout << "Последовательный mt19937 (Training):  " << seqTime / 1000 << " мс\n";
+        double parTime = measureTime([&]() { generateTrainingsParallel(dataSize, numThreads); });
+        std::cout << "Параллельный SplitMix64 (Training):   " << parTime / 1000 << " мс\n";
+    }
+    
+    TrainingColumns single, multi;
+    double singleTime = measureTime([&]() { single = generateTrainingColumns(dataSize, 1); });
+    double multiTime = measureTime([&]() { multi = generateTrainingColumns(dataSize, numThreads); });
+    std::cout << "SplitMix64 в столбцы, 1 поток:        " << singleTime / 1000 << " мс\n";
+    std::cout << "SplitMix64 в столбцы, " << numThreads << " потоков:       " << multiTime / 1000 << " мс\n";
+    
+    uint64_t h1 = hashColumns(single);
+    uint64_t h2 = hashColumns(multi);
+    std::cout << "\nКонтрольная сумма: " << std::hex << h1 << " / " << h2 << std::dec << "\n";
+    std::cout << "Результат не зависит от числа потоков: " << (h1 == h2 ? "✓ ДА" : "✗ НЕТ") << "\n";
+    return h1 == h2 ? 0 : 1;
+}
+
+// Trainer x weekday table plus month and hour histograms in one pass,
+// checked against seven weekday scans counted by the caller
+int runAggregateDemo(size_t dataSize, int numThreads) {
+    TrainingColumns columns = generateTrainingColumns(dataSize, numThreads);
+    TrainingColumnsView view = columns.view();
+    
+    std::vector<GroupCounts> tables;
+    double aggTime = measureTime([&]() {
+        tables = aggregateTrainings(view, {
+            {GroupDimension::Trainer, GroupDimension::Weekday},
+            {GroupDimension::Month},
+            {GroupDimension::Hour}}, numThreads);
+    });
+    
+    std::vector<std::vector<uint64_t>> expected(view.trainerCount, std::vector<uint64_t>(7, 0));
+    double scanTime = measureTime([&]() {
+        for (int d = 0; d < 7; ++d) {
+            for (RowId row : findTrainingsByDayColumns(view, d, numThreads)) {
+                ++expected[view.trainers[row]][d];
+            }
+        }
+    });
+    
+    const GroupCounts& byTrainerDay = tables[0];
+    std::cout << "Тренировки по тренерам и дням недели (" << view.size() << " записей):\n\n";
+    for (int d = 0; d < 7; ++d) {
+        std::cout << std::setw(8) << std::string(DAY_NAMES_EN[d]).substr(0, 3);
+    }
+    std::cout << "   Тренер\n";
+    bool match = true;
+    for (size_t t = 0; t < view.trainerCount; ++t) {
+        for (int d = 0; d < 7; ++d) {
+            uint64_t count = byTrainerDay.at({t, static_cast<size_t>(d)});
+            match = match && count == expected[t][d];
+            std::cout << std::setw(8) << count;
+        }
+        std::cout << "   " << view.trainerNames[t] << "\n";
+    }
+    
+    std::cout << "\nПо месяцам: ";
+    for (uint64_t c : tables[1].counts) std::cout << c << " ";
+    std::cout << "\nПо часам:   ";
+    for (size_t h = 8; h < 22; ++h) std::cout << h << ":" << tables[2].counts[h] << " ";
+    
+    std::cout << std::fixed << std::setprecision(3)
+              << "\n\nАгрегация за один проход: " << aggTime / 1000 << " мс\n"
+              << "7 фильтраций + подсчёт:    " << scanTime / 1000 << " мс\n"
+              << "Результаты совпадают: " << (match ? "✓ ДА" : "✗ НЕТ") << "\n";
+    return match ? 0 : 1;
+}
+
+// Sorted rows of two layouts compared as record sets
+bool sameRecords(const TrainingColumnsView& a, const std::vector<RowId>& rowsA,
+                 const TrainingColumnsView& b, const std::vector<RowId>& rowsB) {
+    std::vector<Training> ta = materialize(a, rowsA);
+    std::vector<Training> tb = materialize(b, rowsB);
+    std::sort(ta.begin(), ta.end());
+    std::sort(tb.begin(), tb.end());
+    return ta == tb;
+}
+
+template<TrainingPredicate Pred>
+bool reportPrunedQuery(const char* name, const TrainingColumnsView& flat,
+                       const BlockedTrainings& blocked, const Pred& pred, int numThreads) {
+    std::vector<RowId> fullRows;
+    double fullTime = measureTime([&]() { fullRows = findTrainings(flat, pred, numThreads); });
+    PrunedScanResult pruned;
+    double prunedTime = measureTime([&]() { pruned = findTrainingsPruned(blocked, pred, numThreads); });
+    bool match = sameRecords(flat, fullRows, blocked.view(), pruned.rows);
+    
+    double skipped = 100.0 * (pruned.blocksTotal - pruned.blocksScanned) / std::max<size_t>(1, pruned.blocksTotal);
+    std::cout << "\n" << name << ": найдено " << pruned.rows.size() << "\n"
+              << "  блоков прочитано: " << pruned.blocksScanned << " из " << pruned.blocksTotal
+              << " (пропущено " << std::setprecision(1) << skipped << "%)\n"
+              << std::setprecision(3)
+              << "  полный скан: " << fullTime / 1000 << " мс, с зонными картами: "
+              << prunedTime / 1000 << " мс, ускорение " << std::setprecision(2)
+              << fullTime / std::max(1.0, prunedTime) << "x "
+              << (match ? "✓" : "✗ результаты различаются") << "\n";
+    return match;
+}
+
+int runZoneMapDemo(size_t dataSize, int numThreads) {
+    TrainingColumns columns = generateTrainingColumns(dataSize, numThreads);
+    TrainingColumnsView flat = columns.view();
+    
+    std::unique_ptr<BlockedTrainings> blocked;
+    double buildTime = measureTime([&]() {
+        blocked = std::make_unique<BlockedTrainings>(flat, numThreads);
+    });
+    std::cout << std::fixed << std::setprecision(3)
+              << "Записей: " << flat.size() << ", блоков по " << BlockedTrainings::BLOCK_ROWS
+              << " строк: " << blocked->blockCount() << "\n"
+              << "Сортировка и построение зонных карт: " << buildTime / 1000 << " мс\n";
+    
+    bool ok = true;
+    ok &= reportPrunedQuery("Март 2024", flat, *blocked,
+        DateRange({1, 3, 2024}, {31, 3, 2024}), numThreads);
+    ok &= reportPrunedQuery("Неделя 10.06.2024-16.06.2024, утро", flat, *blocked,
+        DateRange({10, 6, 2024}, {16, 6, 2024}) && TimeRange({8, 0}, {11, 59}), numThreads);
+    ok &= reportPrunedQuery("Понедельники", flat, *blocked, WeekdayIs(1), numThreads);
+    ok &= reportPrunedQuery("Понедельники 2025 года", flat, *blocked,
+        WeekdayIs(1) && DateRange({1, 1, 2025}, {31, 12, 2025}), numThreads);
+    return ok ? 0 : 1;
+}
+
+// Batch of freshly generated rows starting at record index `first`
+TrainingColumns generateBatch(uint64_t first, size_t count) {
+    TrainingColumns batch;
+    batch.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        GeneratedRecord r = generateRecord(42, first + i);
+        batch.days[i] = r.date.toDays();
+        batch.minutes[i] = static_cast<uint16_t>(r.time.hours * 60 + r.time.minutes);
+        batch.trainers[i] = static_cast<uint16_t>(r.trainer);
+    }
+    return batch;
+}
+
+struct IngestRunStats {
+    uint64_t queries = 0;
+    uint64_t rowsScanned = 0;
+    uint64_t inconsistent = 0;
+    size_t rowsAtEnd = 0;
+};
+
+// Readers loop on snapshot queries for `seconds` while an optional writer
+// appends at `rowsPerSecond` in 1 ms batches
+IngestRunStats runIngestPhase(SegmentedTrainingStore& store, double rowsPerSecond,
+                              double seconds, int numReaders) {
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> queries{0};
+    std::atomic<uint64_t> rowsScanned{0};
+    std::atomic<uint64_t> inconsistent{0};
+    
+    std::thread writer;
+    if (rowsPerSecond > 0) {
+        writer = std::thread([&]() {
+            auto start = std::chrono::steady_clock::now();
+            uint64_t written = store.size();
+            uint64_t initial = written;
+            while (!stop.load()) {
+                double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                uint64_t target = initial + static_cast<uint64_t>(elapsed * rowsPerSecond);
+                if (target > written) {
+                    TrainingColumns batch = generateBatch(written, target - written);
+                    store.append(batch.view());
+                    written = target;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    }
+    
+    std::vector<std::thread> readers;
+    for (int r = 0; r < numReaders; ++r) {
+        readers.emplace_back([&, r]() {
+            WeekdayIs pred(r % 7);
+            while (!stop.load(std::memory_order_relaxed)) {
+                SegmentedTrainingStore::Snapshot snapshot(store);
+                size_t first = findTrainings(snapshot, pred, 1).size();
+                // A snapshot must not change under concurrent appends
+                size_t second = findTrainings(snapshot, pred, 1).size();
+                if (first != second) inconsistent.fetch_add(1);
+                queries.fetch_add(2, std::memory_order_relaxed);
+                rowsScanned.fetch_add(2 * snapshot.size(), std::memory_order_relaxed);
+            }
+        });
+    }
+    
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop.store(true);
+    for (auto& t : readers) t.join();
+    if (writer.joinable()) writer.join();
+    
+    return {queries.load(), rowsScanned.load(), inconsistent.load(), store.size()};
+}
+
+int runIngestDemo(size_t initialRows, double rowsPerSecond, double seconds, int numReaders) {
+    SegmentedTrainingStore store(TRAINER_NAMES);
+    TrainingColumns initial = generateTrainingColumns(initialRows, 4);
+    store.append(initial.view());
+    
+    std::cout << "Начальный размер: " << store.size() << ", сегмент: "
+              << SegmentedTrainingStore::SEGMENT_ROWS << " строк, читателей: " << numReaders << "\n";
+    
+    IngestRunStats idle = runIngestPhase(store, 0, seconds, numReaders);
+    size_t before = store.size();
+    IngestRunStats busy = runIngestPhase(store, rowsPerSecond, seconds, numReaders);
+    
+    // Final snapshot cross-checked against a flat copy of the same rows
+    SegmentedTrainingStore::Snapshot snapshot(store);
+    std::vector<size_t> rows = findTrainings(snapshot, WeekdayIs(1), 4);
+    TrainingColumns flat = generateBatch(0, snapshot.size());
+    flat.trainerNames = TRAINER_NAMES;
+    std::vector<RowId> expected = findTrainingsByDayColumns(flat.view(), 1, 4);
+    bool match = std::equal(rows.begin(), rows.end(), expected.begin(), expected.end());
+    for (size_t i = 0; match && i < rows.size(); ++i) {
+        match = snapshot.toTraining(rows[i]) == flat.view().toTraining(expected[i]);
+    }
+    
+    std::cout << std::fixed << std::setprecision(1)
+              << "\nБез записи:     " << idle.queries / seconds << " запросов/с, "
+              << idle.rowsScanned / seconds / 1e6 << " млн строк/с\n"
+              << "С записью:      " << busy.queries / seconds << " запросов/с, "
+              << busy.rowsScanned / seconds / 1e6 << " млн строк/с при "
+              << (busy.rowsAtEnd - before) / seconds << " записей/с (цель "
+              << rowsPerSecond << ")\n"
+              << "Итоговый размер: " << busy.rowsAtEnd
+              << ", освобождено каталогов сегментов: " << store.reclaimedDirectories() << "\n"
+              << "Снимки согласованы: " << (busy.inconsistent == 0 && idle.inconsistent == 0 ? "✓ ДА" : "✗ НЕТ") << "\n"
+              << "Итоговый снимок совпадает с эталоном: " << (match ? "✓ ДА" : "✗ НЕТ") << "\n";
+    return match && busy.inconsistent == 0 ? 0 : 1;
+}
+
+int runOrderedDemo(size_t dataSize, int numThreads) {
+    TrainingColumns columns = generateTrainingColumns(dataSize, numThreads);
+    TrainingColumnsView view = columns.view();
+    WeekdayIs pred(3);
+    bool ok = true;
+    
+    std::cout << "Записей: " << view.size() << ", потоков: " << numThreads << ", запрос: среды\n";
+    const std::pair<OrderBy, const char*> keys[] = {
+        {OrderBy::Date, "дата"}, {OrderBy::Time, "время"}, {OrderBy::Trainer, "тренер"}};
+    for (const auto& [key, name] : keys) {
+        for (bool descending : {false, true}) {
+            std::vector<RowId> full, top;
+            std::vector<OrderedRow> reference;
+            double fullTime = measureTime([&]() {
+                full = findTrainingsOrdered(view, pred, {key, descending, 0}, numThreads);
+            });
+            double topTime = measureTime([&]() {
+                top = findTrainingsOrdered(view, pred, {key, descending, 10}, numThreads);
+            });
+            double serialTime = measureTime([&]() {
+                OrderKeyBuilder keyOf(view, {key, descending, 0});
+                for (RowId row : findTrainings(view, pred, 1)) reference.push_back(keyOf(row));
+                std::sort(reference.begin(), reference.end());
+            });
+            
+            bool match = full.size() == reference.size() && top.size() == std::min<size_t>(10, full.size());
+            for (size_t i = 0; match && i < full.size(); ++i) {
+                match = full[i] == reference[i].row && (i >= top.size() || top[i] == full[i]);
+            }
+            ok = ok && match;
+            
+            std::cout << std::fixed << std::setprecision(3) << "\n" << name
+                      << (descending ? " (по убыванию)" : " (по возрастанию)") << "\n"
+                      << "  std::sort в 1 поток:  " << serialTime / 1000 << " мс\n"
+                      << "  параллельная сортировка: " << fullTime / 1000 << " мс (" << full.size() << " записей)\n"
+                      << "  топ-10 через кучи:    " << topTime / 1000 << " мс "
+                      << (match ? "✓" : "✗ результаты различаются") << "\n";
+            if (!top.empty()) {
+                std::cout << "  первая: " << view.toTraining(top.front()).toString() << "\n";
+            }
+        }
+    }
+    return ok ? 0 : 1;
+}
+
+// Dashboard simulation: callers repeatedly ask for a few weekday queries,
+// once without and once with the cache, then the dataset changes
+int runCacheDemo(size_t dataSize, int numThreads, size_t budgetBytes) {
+    TrainingColumns columns = generateTrainingColumns(dataSize, numThreads);
+    QueryResultCache cache(budgetBytes);
+    const int callers = 4;
+    const int requestsPerCaller = 50;
+    
+    auto makeSpec = [](int caller, int request) {
+        QuerySpec spec;
+        spec.weekdayMask = static_cast<uint8_t>(1u << ((caller + request) % 7));
+        if (request % 3 == 0) {
+            spec.fromMinutes = 8 * 60;
+            spec.toMinutes = 12 * 60 - 1;
+        }
+        return spec.normalize();
+    };
+    
+    auto runCallers = [&](bool useCache) {
+        std::atomic<bool> ok{true};
+        std::vector<std::thread> threads;
+        for (int c = 0; c < callers; ++c) {
+            threads.emplace_back([&, c]() {
+                for (int r = 0; r < requestsPerCaller; ++r) {
+                    QuerySpec spec = makeSpec(c, r);
+                    TrainingColumnsView view = columns.view();
+                    auto compute = [&]() { return findTrainings(view, spec, 1); };
+                    size_t rows = useCache ? cache.getOrCompute(spec, columns.version, compute)->size()
+                                           : compute().size();
+                    if (rows == 0) ok.store(false);
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+        return ok.load();
+    };
+    
+    double uncachedTime = measureTime([&]() { runCallers(false); });
+    double cachedTime = measureTime([&]() { runCallers(true); });
+    QueryResultCache::Stats before = cache.stats();
+    
+    // A new booking bumps the version: the next lookups must recompute
+    columns.append(Date{2, 1, 2023}.toDays(), 9 * 60, 0);  // a Monday
+    QuerySpec monday;
+    monday.weekdayMask = 1u << 1;
+    monday.normalize();
+    auto fresh = cache.getOrCompute(monday, columns.version,
+        [&]() { return findTrainings(columns.view(), monday, numThreads); });
+    bool match = *fresh == findTrainings(columns.view(), monday, numThreads);
+    QueryResultCache::Stats after = cache.stats();
+    
+    std::cout << std::fixed << std::setprecision(3)
+              << "Записей: " << dataSize << ", вызывающих потоков: " << callers
+              << ", запросов каждого: " << requestsPerCaller << ", бюджет: " << budgetBytes / (1 << 20) << " МБ\n\n"
+              << "Без кэша:  " << uncachedTime / 1000 << " мс\n"
+              << "С кэшем:   " << cachedTime / 1000 << " мс\n"
+              << "Попадания: " << before.hits << ", промахи: " << before.misses
+              << ", вытеснения: " << before.evictions << ", записей: " << before.entries
+              << ", занято: " << before.bytes / 1024 << " КБ\n"
+              << "После изменения данных: устаревших промахов " << after.staleMisses - before.staleMisses
+              << ", результат актуален: " << (match ? "✓ ДА" : "✗ НЕТ") << "\n";
+    return match ? 0 : 1;
+}
+
+// Dataset source is either a training file or a generated dataset size
+int runServer(const std::string& socketPath, const std::string& source, int numThreads, long windowUs) {
+    std::signal(SIGPIPE, SIG_IGN);
+    std::unique_ptr<MappedTrainingFile> file;
+    TrainingColumns generated;
+    TrainingColumnsView view;
+    if (source.size() > 4 && source.compare(source.size() - 4, 4, ".bin") == 0) {
+        file = std::make_unique<MappedTrainingFile>(source);
+        view = file->view();
+    } else {
+        generated = generateTrainingColumns(std::stoul(source), numThreads);
+        view = generated.view();
+    }
+    
+    TrainingQueryServer server(view, numThreads, std::chrono::microseconds(windowUs), 256 << 20);
+    std::cerr << "Загружено записей: " << view.size() << ", окно пакетирования: " << windowUs << " мкс\n";
+    if (socketPath == "-") {
+        server.serveConnection(STDIN_FILENO, STDOUT_FILENO);
+    } else {
+        std::cerr << "Ожидание подключений на " << socketPath << "\n";
+        server.serveSocket(socketPath);
+    }
+    std::cerr << server.statistics() << "\n";
+    return 0;
+}
+
+int runClient(const std::string& socketPath, int connections, int requestsPerConnection) {
+    LoadReport report = runLoadGenerator(socketPath, connections, requestsPerConnection);
+    auto pct = [&](double p) {
+        size_t rank = static_cast<size_t>(p / 100.0 * (report.latenciesUs.size() - 1) + 0.5);
+        return report.latenciesUs[rank] / 1000;
+    };
+    std::cout << std::fixed << std::setprecision(3)
+              << "Запросов: " << report.latenciesUs.size() << " по " << connections << " соединениям, ошибок: "
+              << report.errors << "\n"
+              << "QPS: " << std::setprecision(1) << report.latenciesUs.size() / report.seconds << "\n"
+              << std::setprecision(3)
+              << "Задержка p50: " << pct(50) << " мс, p99: " << pct(99) << " мс, max: " << pct(100) << " мс\n";
+    return report.errors == 0 ? 0 : 1;
+}
+
+// Nightly export: all seven weekday subsets, by seven filters versus one partition
+int runPartitionDemo(size_t dataSize, int numThreads) {
+    TrainingColumns columns = generateTrainingColumns(dataSize, numThreads);
+    TrainingColumnsView view = columns.view();
+    
+    std::vector<std::vector<PackedTraining>> filtered(7);
+    double filterTime = measureTime([&]() {
+        for (int d = 0; d < 7; ++d) {
+            for (RowId row : findTrainingsByDayColumns(view, d, numThreads)) {
+                filtered[d].push_back({view.days[row], view.minutes[row], view.trainers[row]});
+            }
+        }
+    });
+    
+    WeekdayPartitions partitions;
+    double partitionTime = measureTime([&]() { partitions = partitionByWeekday(view, numThreads); });
+    
+    bool match = true;
+    std::cout << "Записей: " << view.size() << ", потоков: " << numThreads << "\n\n";
+    for (int d = 0; d < 7; ++d) {
+        match = match && partitions.size(d) == filtered[d].size() &&
+            std::equal(partitions.begin(d), partitions.end(d), filtered[d].begin(),
+                [](const PackedTraining& a, const PackedTraining& b) {
+                    return a.days == b.days && a.minutes == b.minutes && a.trainer == b.trainer;
+                });
+        std::cout << "  " << DAY_NAMES[d] << ": " << partitions.size(d) << "\n";
+    }
+    std::cout << std::fixed << std::setprecision(3)
+              << "\n7 фильтраций:          " << filterTime / 1000 << " мс\n"
+              << "Разбиение за проход:   " << partitionTime / 1000 << " мс\n"
+              << "Результаты совпадают: " << (match ? "✓ ДА" : "✗ НЕТ") << "\n";
+    return match ? 0 : 1;
+}
+
+int parseDayArg(const char* arg) {
+    int day = std::stoi(arg);
+    if (day < 0 || day > 6) {
+        throw std::invalid_argument("неверный номер дня недели (должен быть 0-6)");
+    }
+    return day;
+}
+
+int runCommand(int argc, char* argv[]) {
+    std::string command = argv[1];
+    auto threadsArg = [&](int index) { return argc > index ? std::max(1, std::stoi(argv[index])) : 4; };
+    
+    try {
+        if (command == "--make-csv" && argc >= 4) {
+            return runMakeCsv(argv[2], std::stoul(argv[3]));
+        }
+        if (command == "--import" && argc >= 4) {
+            return runImport(argv[2], argv[3], threadsArg(4));
+        }
+        if (command == "--query" && argc >= 4) {
+            return runQueryFile(argv[2], parseDayArg(argv[3]), threadsArg(4));
+        }
+        if (command == "--generate" && argc >= 3) {
+            return runGenerateDemo(std::stoul(argv[2]), threadsArg(3));
+        }
+        if (command == "--aggregate" && argc >= 3) {
+            return runAggregateDemo(std::stoul(argv[2]), threadsArg(3));
+        }
+        if (command == "--zonemap" && argc >= 3) {
+            return runZoneMapDemo(std::stoul(argv[2]), threadsArg(3));
+        }
+        if (command == "--ingest" && argc >= 5) {
+            return runIngestDemo(std::stoul(argv[2]), std::stod(argv[3]), std::stod(argv[4]),
+                                 argc > 5 ? std::max(1, std::stoi(argv[5])) : 2);
+        }
+        if (command == "--bench") {
+            BenchConfig config;
+            if (argc > 2) config.maxSize = std::stoul(argv[2]);
+            if (argc > 3) config.maxThreads = std::max(1, std::stoi(argv[3]));
+            if (argc > 4) config.repeats = std::max(1, std::stoi(argv[4]));
+            if (argc > 5) config.jsonPath = argv[5];
+            std::vector<BenchRecord> records = runBenchmarkSuite(config);
+            bool allCorrect = std::all_of(records.begin(), records.end(),
+                [](const BenchRecord& r) { return r.correct; });
+            return allCorrect ? 0 : 1;
+        }
+        if (command == "--ordered" && argc >= 3) {
+            return runOrderedDemo(std::stoul(argv[2]), threadsArg(3));
+        }
+        if (command == "--cache" && argc >= 3) {
+            size_t budgetMb = argc > 4 ? std::stoul(argv[4]) : 64;
+            return runCacheDemo(std::stoul(argv[2]), threadsArg(3), budgetMb << 20);
+        }
+        if (command == "--server" && argc >= 4) {
+            return runServer(argv[2], argv[3], threadsArg(4), argc > 5 ? std::stol(argv[5]) : 2000);
+        }
+        if (command == "--client" && argc >= 3) {
+            return runClient(argv[2], argc > 3 ? std::max(1, std::stoi(argv[3])) : 8,
+                             argc > 4 ? std::max(1, std::stoi(argv[4])) : 200);
+        }
+        if (command == "--partition" && argc >= 3) {
+            return runPartitionDemo(std::stoul(argv[2]), threadsArg(3));
+        }
+        if (command == "--queries" && argc >= 3) {
+            return runQueriesDemo(std::stoul(argv[2]), threadsArg(3));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Ошибка: " << e.what() << "\n";
+        return 1;
+    }
+    
+    printUsage(argv[0]);
+    return 1;
+}
+
+// ==================== Main ====================
+
+int main(int argc, char* argv[]) {
+    if (argc >= 2 && std::strncmp(argv[1], "--", 2) == 0) {
+        return runCommand(argc, argv);
+    }
+    
+    // Parameters - use command line args or defaults for testing
+    size_t dataSize = 500000;
+    int numThreads = 4;
+    int targetDay = 1; // Monday
+    
+    if (argc >= 4) {
+        dataSize = std::stoul(argv[1]);
+        numThreads = std::stoi(argv[2]);
+        targetDay = std::stoi(argv[3]);
+    } else if (argc == 1) {
+        std::cout << "\nИспользование: " << argv[0] << " <размер_данных> <кол-во_потоков> <день_недели>\n";
+        std::cout << "Используются значения по умолчанию: " << dataSize << " " << numThreads << " " << targetDay << "\n";
+    }
+    
+    std::cout << "\nДни недели:\n";
+    for (int i = 0; i < 7; ++i) {
+        std::cout << "  " << i << " - " << DAY_NAMES[i] << "\n";
+    }
+    
+    if (targetDay < 0 || targetDay > 6) {
+        std::cerr << "Ошибка: неверный номер дня недели (должен быть 0-6)!\n";
+        return 1;
+    }
+    
+    std::cout << "\nВыбранный день: " << DAY_NAMES[targetDay] << " (" << targetDay << ")\n";
+    
+    // Generate data
+    std::cout << "\n" << std::string(60, '=') << "\n";
+    std::cout << "Генерация данных...\n";
+    auto genStart = std::chrono::steady_clock::now();
+    std::vector<Training> trainings = generateTrainingsParallel(dataSize, numThreads);
+    auto genEnd = std::chrono::steady_clock::now();
+    auto genTime = std::chrono::duration_cast<std::chrono::milliseconds>(genEnd - genStart).count();
+    
+    std::cout << "Сгенерировано " << trainings.size() << " записей за " << genTime << " мс\n";
+    std::cout << std::string(60, '=') << "\n";
+    
+    // Single-threaded processing
+    std::cout << "\n>>> Однопоточная обработка...\n";
+    std::vector<Training> singleResult;
+    double singleTime = measureTime([&]() {
+        singleResult = findTrainingsByDaySingleThread(trainings, targetDay);
+    });
+    
+    std::cout << "Найдено записей: " << singleResult.size() << "\n";
+    std::cout << "Время выполнения: " << std::fixed << std::setprecision(2) 
+              << singleTime << " мкс (" << singleTime / 1000 << " мс)\n";
+    
+    // Multi-threaded processing (mutex)
+    std::cout << "\n>>> Многопоточная обработка (с mutex)...\n";
+    std::cout << "Количество потоков: " << numThreads << "\n";
+    std::vector<Training> multiMutexResult;
+    double multiMutexTime = measureTime([&]() {
+        multiMutexResult = findTrainingsByDayMultiThreadMutex(trainings, targetDay, numThreads);
+    });
+    
+    std::cout << "Найдено записей: " << multiMutexResult.size() << "\n";
+    std::cout << "Время выполнения: " << std::fixed << std::setprecision(2) 
+              << multiMutexTime << " мкс (" << multiMutexTime / 1000 << " мс)\n";
+    
+    // Multi-threaded processing (count + prefix sum + scatter)
+    std::cout << "\n>>> Многопоточная обработка (подсчёт + префиксная сумма + запись)...\n";
+    std::vector<Training> scatterResult;
+    double scatterTime = measureTime([&]() {
+        scatterResult = findTrainingsByDayScatter(trainings, targetDay, numThreads);
+    });
+    
+    std::cout << "Найдено записей: " << scatterResult.size() << "\n";
+    std::cout << "Время выполнения: " << std::fixed << std::setprecision(2) 
+              << scatterTime << " мкс (" << scatterTime / 1000 << " мс)\n";
+    
+    // Results comparison
+    std::cout << "\n" << std::string(60, '=') << "\n";
+    std::cout << "                    РЕЗУЛЬТАТЫ СРАВНЕНИЯ\n";
+    std::cout << std::string(60, '=') << "\n";
+    
+    std::cout << "\nПараметры теста:\n";
+    std::cout << "  - Размер данных: " << dataSize << " записей\n";
+    std::cout << "  - Количество потоков: " << numThreads << "\n";
+    std::cout << "  - Искомый день недели: " << DAY_NAMES[targetDay] << "\n";
+    
+    std::cout << "\n┌────────────────────────────────┬──────────────┬────────────┐\n";
+    std::cout << "│ Метод                          │  Время (мс)  │ Ускорение  │\n";
+    std::cout << "├────────────────────────────────┼──────────────┼────────────┤\n";
+    std::cout << "│ Однопоточный                   │ " << std::setw(12) << std::fixed 
+              << std::setprecision(3) << singleTime / 1000 << " │     1.00x  │\n";
+    std::cout << "│ Многопоточный (с mutex)        │ " << std::setw(12) << std::fixed 
+              << std::setprecision(3) << multiMutexTime / 1000 << " │ " << std::setw(8) 
+              << std::setprecision(2) << singleTime / multiMutexTime << "x  │\n";
+    std::cout << "│ Многопоточный (scatter)        │ " << std::setw(12) << std::fixed 
+              << std::setprecision(3) << scatterTime / 1000 << " │ " << std::setw(8) 
+              << std::setprecision(2) << singleTime / scatterTime << "x  │\n";
+    std::cout << "└────────────────────────────────┴──────────────┴────────────┘\n";
+    
+    // Display sample results
+    std::cout << "\n" << std::string(60, '=') << "\n";
+    std::cout << "ПРИМЕРЫ НАЙДЕННЫХ ЗАПИСЕЙ (10 самых ранних):\n";
+    std::cout << std::string(60, '=') << "\n";
+    std::cout << "Тренировки в " << DAY_NAMES[targetDay] << ":\n\n";
+    
+    // Earliest trainings via a top-K query instead of whatever came first
+    TrainingColumns columns = toColumns(trainings);
+    TrainingColumnsView view = columns.view();
+    std::vector<RowId> earliest = findTrainingsOrdered(view, WeekdayIs(targetDay),
+        {OrderBy::Date, false, 10}, numThreads);
+    for (size_t i = 0; i < earliest.size(); ++i) {
+        std::cout << std::setw(3) << (i + 1) << ". " << view.toTraining(earliest[i]).toString() << "\n";
     }
     
     if (singleResult.size() > 10) {
@@ -353,8 +3595,16 @@ int main(int argc, char* argv[]) {
     // Verify results match
     std::cout << "\n" << std::string(60, '=') << "\n";
     std::cout << "ВЕРИФИКАЦИЯ РЕЗУЛЬТАТОВ:\n";
-    bool resultsMatch = (singleResult.size() == multiResult.size()) && 
-                        (singleResult.size() == multiMutexResult.size());
+    // The scatter method must match record by record; the mutex variant
+    // appends chunks in completion order, so compare it sorted
+    bool orderedMatch = singleResult == scatterResult;
+    std::vector<Training> sortedSingle = singleResult;
+    std::vector<Training> sortedMutex = multiMutexResult;
+    std::sort(sortedSingle.begin(), sortedSingle.end());
+    std::sort(sortedMutex.begin(), sortedMutex.end());
+    bool resultsMatch = orderedMatch && (sortedSingle == sortedMutex);
+    std::cout << "Порядок записей сохранён (scatter): " 
+              << (orderedMatch ? "✓ ДА" : "✗ НЕТ") << "\n";
     std::cout << "Результаты всех методов совпадают: " 
               << (resultsMatch ? "✓ ДА" : "✗ НЕТ") << "\n";
     
@@ -9,20 +9,1181 @@
 #include <chrono>
 #include <algorithm>
 #include <stdexcept>
+#include <queue>
+#include <functional>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <atomic>
+#include <array>
+#include <memory>
+#include <fstream>
+#include <barrier>
+#include <latch>
+#include <set>
+#include <deque>
+#include <future>
+#include <optional>
+#include <coroutine>
+#include <bit>
+#include <sstream>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// ==================== SIMD Row Kernels ====================
+
+// Matrix rows are padded with zeros to a multiple of SIMD_WIDTH ints, so the
+// kernels below never need a scalar tail
+constexpr int SIMD_WIDTH = 8;
+
+inline int paddedWidth(int columns) {
+    return (columns + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+}
+
+// a[j] <= b[j] for every j < n. Compares whole vectors without early exit
+inline bool rowLessEqual(const int* a, const int* b, int n) {
+#if defined(__AVX2__)
+    __m256i greater = _mm256_setzero_si256();
+    for (int j = 0; j < n; j += 8) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + j));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+        greater = _mm256_or_si256(greater, _mm256_cmpgt_epi32(va, vb));
+    }
+    return _mm256_testz_si256(greater, greater);
+#else
+    // Branch-free so the compiler can vectorize it for the baseline ISA
+    int greater = 0;
+    for (int j = 0; j < n; ++j) {
+        greater |= a[j] > b[j];
+    }
+    return greater == 0;
+#endif
+}
+
+// dst[j] += src[j]
+inline void addRow(int* dst, const int* src, int n) {
+#if defined(__AVX2__)
+    for (int j = 0; j < n; j += 8) {
+        __m256i vd = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + j));
+        __m256i vs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + j));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + j), _mm256_add_epi32(vd, vs));
+    }
+#else
+    for (int j = 0; j < n; ++j) {
+        dst[j] += src[j];
+    }
+#endif
+}
+
+// dst[j] = min(dst[j] + src[j], cap) without overflow, given dst[j] <= cap
+inline void addRowSaturating(int* dst, const int* src, int cap, int n) {
+#if defined(__AVX2__)
+    __m256i vc = _mm256_set1_epi32(cap);
+    for (int j = 0; j < n; j += 8) {
+        __m256i vd = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + j));
+        __m256i vs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + j));
+        vs = _mm256_min_epi32(vs, _mm256_sub_epi32(vc, vd));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + j), _mm256_add_epi32(vd, vs));
+    }
+#else
+    for (int j = 0; j < n; ++j) {
+        dst[j] += std::min(src[j], cap - dst[j]);
+    }
+#endif
+}
+
+// dst[j] -= src[j]
+inline void subRow(int* dst, const int* src, int n) {
+#if defined(__AVX2__)
+    for (int j = 0; j < n; j += 8) {
+        __m256i vd = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + j));
+        __m256i vs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + j));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + j), _mm256_sub_epi32(vd, vs));
+    }
+#else
+    for (int j = 0; j < n; ++j) {
+        dst[j] -= src[j];
+    }
+#endif
+}
+
+// dst[j] = min(dst[j], src[j])
+inline void minRow(int* dst, const int* src, int n) {
+#if defined(__AVX2__)
+    for (int j = 0; j < n; j += 8) {
+        __m256i vd = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + j));
+        __m256i vs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + j));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + j), _mm256_min_epi32(vd, vs));
+    }
+#else
+    for (int j = 0; j < n; ++j) {
+        dst[j] = std::min(dst[j], src[j]);
+    }
+#endif
+}
+
+// ==================== Incremental Safety ====================
+
+// Segment tree over the steps of a safe sequence. Leaf k holds the slack
+// work_k - need[s_k] of step k (work_k being the work vector before s_k
+// runs); inner nodes hold componentwise minima plus a pending addition for
+// lazy range updates. Only prefixes are ever queried or updated, because a
+// grant to the process at step q lowers work for steps 0..q and leaves the
+// rest of the sequence untouched.
+class SlackTree {
+public:
+    // Large enough to never constrain. Additions saturate at it, so empty
+    // and released steps stay sentinels however much capacity is added
+    static constexpr int UNBOUNDED = std::numeric_limits<int>::max() / 2;
+
+    // slack holds count rows of width stride
+    void build(const std::vector<int>& slack, int count, int rowWidth) {
+        stride = rowWidth;
+        leaves = 1;
+        while (leaves < std::max(count, 1)) leaves *= 2;
+        minimum.assign(static_cast<size_t>(2 * leaves) * stride, UNBOUNDED);
+        pending.assign(static_cast<size_t>(2 * leaves) * stride, 0);
+        std::copy(slack.begin(), slack.begin() + static_cast<size_t>(count) * stride, node(minimum, leaves));
+        for (int i = leaves - 1; i >= 1; --i) {
+            pull(i);
+        }
+    }
+
+    // True if req[j] <= slack_k[j] for every step k < end
+    bool coversPrefix(int end, const int* req) {
+        return covers(1, 0, leaves, end, req);
+    }
+
+    // slack_k += sign * delta for every step k < end
+    void addPrefix(int end, const int* delta, int sign) {
+        add(1, 0, leaves, end, delta, sign);
+    }
+
+    // Step pos no longer constrains anything (its process has finished)
+    void release(int pos) {
+        int i = 1, lo = 0, hi = leaves;
+        while (hi - lo > 1) {
+            push(i);
+            int mid = (lo + hi) / 2;
+            if (pos < mid) { i = 2 * i; hi = mid; }
+            else { i = 2 * i + 1; lo = mid; }
+        }
+        std::fill(node(minimum, i), node(minimum, i) + stride, UNBOUNDED);
+        for (i /= 2; i >= 1; i /= 2) {
+            pull(i);
+        }
+    }
+
+private:
+    int stride = 0;
+    int leaves = 0;
+    std::vector<int> minimum;
+    std::vector<int> pending;
+
+    int* node(std::vector<int>& values, int i) {
+        return values.data() + static_cast<size_t>(i) * stride;
+    }
+
+    void apply(int i, const int* delta, int sign) {
+        if (sign > 0) {
+            addRowSaturating(node(minimum, i), delta, UNBOUNDED, stride);
+            addRow(node(pending, i), delta, stride);
+        } else {
+            subRow(node(minimum, i), delta, stride);
+            subRow(node(pending, i), delta, stride);
+        }
+    }
+
+    void push(int i) {
+        int* lazy = node(pending, i);
+        apply(2 * i, lazy, 1);
+        apply(2 * i + 1, lazy, 1);
+        std::fill(lazy, lazy + stride, 0);
+    }
+
+    void pull(int i) {
+        std::copy(node(minimum, 2 * i), node(minimum, 2 * i) + stride, node(minimum, i));
+        minRow(node(minimum, i), node(minimum, 2 * i + 1), stride);
+    }
+
+    bool covers(int i, int lo, int hi, int end, const int* req) {
+        if (lo >= end) return true;
+        if (hi <= end) return rowLessEqual(req, node(minimum, i), stride);
+        push(i);
+        int mid = (lo + hi) / 2;
+        return covers(2 * i, lo, mid, end, req) && covers(2 * i + 1, mid, hi, end, req);
+    }
+
+    void add(int i, int lo, int hi, int end, const int* delta, int sign) {
+        if (lo >= end) return;
+        if (hi <= end) {
+            apply(i, delta, sign);
+            return;
+        }
+        push(i);
+        int mid = (lo + hi) / 2;
+        add(2 * i, lo, mid, end, delta, sign);
+        add(2 * i + 1, mid, hi, end, delta, sign);
+        pull(i);
+    }
+};
+
+// ==================== Thread Pool ====================
+
+// Runs tasks posted from any thread on a fixed set of threads, in FIFO
+// order. The destructor finishes the queued tasks before joining
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads) {
+        for (int t = 0; t < std::max(1, threads); ++t) {
+            workers.emplace_back([this]() { run(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        cv.notify_one();
+    }
+
+    // Queues the tasks back to back, so tasks that wait for each other
+    // never interleave with another batch; a batch no larger than the pool
+    // then always runs all at once
+    void postBatch(std::vector<std::function<void()>> batch) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& task : batch) tasks.push_back(std::move(task));
+        }
+        cv.notify_all();
+    }
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> tasks;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    void run() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+// ==================== Safety Algorithm ====================
+
+// Read-only view of the matrices the safety algorithm reads. Row r of need
+// and allocation starts at r * stride
+struct SafetyView {
+    int rows;
+    int resources;
+    int stride;
+    const int* available;
+    const int* need;
+    const int* allocation;
+
+    const int* needRow(int r) const { return need + static_cast<size_t>(r) * stride; }
+    const int* allocationRow(int r) const { return allocation + static_cast<size_t>(r) * stride; }
+};
+
+constexpr size_t QUEUE_PHASE_MIN_PROCESSES = 64;
+
+// Queue phase of computeSafeSequence for the processes in remaining, starting
+// from work. Candidates are taken lowest id first.
+bool finishWithNeedQueues(const SafetyView& view, const std::vector<int>& remaining,
+                          std::vector<int>& work, std::vector<int>& sequence) {
+    std::vector<int> blockedBy(view.rows, 0);
+    std::priority_queue<int, std::vector<int>, std::greater<int>> ready;
+
+    // All queues share one buffer: queue j is keys[start[j], start[j+1]),
+    // each key packs (need << 32 | process) so a plain sort orders by need
+    std::vector<size_t> start(view.resources + 1, 0);
+    for (int i : remaining) {
+        const int* needRow = view.needRow(i);
+        for (int j = 0; j < view.resources; ++j) {
+            if (needRow[j] > work[j]) {
+                start[j + 1]++;
+                blockedBy[i]++;
+            }
+        }
+        if (blockedBy[i] == 0) ready.push(i);
+    }
+    for (int j = 0; j < view.resources; ++j) {
+        start[j + 1] += start[j];
+    }
+
+    std::vector<uint64_t> keys(start[view.resources]);
+    std::vector<size_t> cursor(start.begin(), start.end() - 1);
+    for (int i : remaining) {
+        if (blockedBy[i] == 0) continue;
+        const int* needRow = view.needRow(i);
+        for (int j = 0; j < view.resources; ++j) {
+            if (needRow[j] > work[j]) {
+                keys[cursor[j]++] = static_cast<uint64_t>(needRow[j]) << 32 | static_cast<uint32_t>(i);
+            }
+        }
+    }
+    for (int j = 0; j < view.resources; ++j) {
+        std::sort(keys.begin() + start[j], keys.begin() + start[j + 1]);
+        cursor[j] = start[j];
+    }
+
+    size_t finishedHere = 0;
+    while (!ready.empty()) {
+        int i = ready.top();
+        ready.pop();
+        sequence.push_back(i);
+        finishedHere++;
+
+        const int* allocRow = view.allocationRow(i);
+        addRow(work.data(), allocRow, view.stride);
+        for (int j = 0; j < view.resources; ++j) {
+            if (allocRow[j] == 0) continue;
+            uint64_t limit = static_cast<uint64_t>(work[j]) << 32 | 0xFFFFFFFFu;
+            size_t& pos = cursor[j];
+            while (pos < start[j + 1] && keys[pos] <= limit) {
+                int unblocked = static_cast<int>(keys[pos] & 0xFFFFFFFFu);
+                if (--blockedBy[unblocked] == 0) ready.push(unblocked);
+                pos++;
+            }
+        }
+    }
+    return finishedHere == remaining.size();
+}
+
+// Safety algorithm in two phases. Cheap scan rounds run for a budget of
+// four full passes and after that only while each round retires at least
+// 1/8 of the remaining processes or a short tail is left, so this phase
+// costs O(n·m) in total and typical states finish in it. If a round stalls
+// below that, the rest switches to per-resource need queues: queue j holds
+// the processes whose need of resource j exceeds work, sorted by that
+// need, and its cursor advances only while work[j] covers the head. A
+// process becomes a candidate once no queue blocks it, so each
+// (process, resource) pair is visited once: O(n·m·log n) instead of the
+// O(n²·m) of scanning round after round. remaining lists the candidate rows;
+// sequence receives rows, not process ids, when the view is a compact copy.
+bool computeSafeSequence(const SafetyView& view, std::vector<int> remaining,
+                         std::vector<int>& sequence) {
+    std::vector<int> work(view.available, view.available + view.stride);
+    sequence.clear();
+
+    const size_t scanBudget = 4 * remaining.size();
+    size_t visited = 0;
+    while (!remaining.empty()) {
+        size_t before = remaining.size();
+        size_t kept = 0;
+        for (int i : remaining) {
+            if (rowLessEqual(view.needRow(i), work.data(), view.stride)) {
+                // Process i can finish, release its resources
+                addRow(work.data(), view.allocationRow(i), view.stride);
+                sequence.push_back(i);
+            } else {
+                remaining[kept++] = i;
+            }
+        }
+        remaining.resize(kept);
+        if (kept == before) return false;
+        visited += before;
+        if (visited > scanBudget && (before - kept) * 8 < before &&
+            kept > QUEUE_PHASE_MIN_PROCESSES) {
+            break;
+        }
+    }
+    if (remaining.empty()) return true;
+
+    return finishWithNeedQueues(view, remaining, work, sequence);
+}
+
+// Parallel version of computeSafeSequence's scan phase, same verdict. Each
+// round splits the candidates among the threads, which test them against
+// the work vector as it was at the start of the round and sum the freed
+// allocations into private deltas; then every thread adds one column range
+// of all deltas into work. A stalled round hands over to the sequential
+// queue phase under the same rule as computeSafeSequence. The calling
+// thread works alongside the helpers, which stay alive between checks.
+bool computeSafeSequenceParallel(const SafetyView& view, std::vector<int> remaining,
+                                 std::vector<int>& sequence, ThreadPool& helpers) {
+    std::vector<int> work(view.available, view.available + view.stride);
+    sequence.clear();
+    if (remaining.empty()) return true;
+    const int threads = std::min(helpers.size() + 1, static_cast<int>(remaining.size()));
+
+    struct Share {
+        std::vector<int> finished;
+        std::vector<int> kept;
+        std::vector<int> delta;
+    };
+    std::vector<Share> shares(threads);
+    for (Share& share : shares) share.delta.assign(view.stride, 0);
+
+    const size_t scanBudget = 4 * remaining.size();
+    size_t visited = 0;
+    bool done = false, safe = false, stalled = false;
+
+    // Runs on one thread once everyone has finished the column reduction
+    auto endRound = [&]() noexcept {
+        size_t before = remaining.size();
+        remaining.clear();
+        for (Share& share : shares) {
+            sequence.insert(sequence.end(), share.finished.begin(), share.finished.end());
+            remaining.insert(remaining.end(), share.kept.begin(), share.kept.end());
+            share.finished.clear();
+            share.kept.clear();
+        }
+        size_t retired = before - remaining.size();
+        visited += before;
+        if (remaining.empty()) {
+            done = safe = true;
+        } else if (retired == 0) {
+            done = true;
+        } else if (visited > scanBudget && retired * 8 < before &&
+                   remaining.size() > QUEUE_PHASE_MIN_PROCESSES) {
+            done = stalled = true;
+        }
+    };
+    std::barrier evaluated(threads);
+    std::barrier reduced(threads, endRound);
+
+    auto worker = [&](int t) {
+        Share& share = shares[t];
+        const int columnBegin = view.stride * t / threads;
+        const int columnEnd = view.stride * (t + 1) / threads;
+        while (true) {
+            size_t count = remaining.size();
+            for (size_t k = count * t / threads; k < count * (t + 1) / threads; ++k) {
+                int i = remaining[k];
+                if (rowLessEqual(view.needRow(i), work.data(), view.stride)) {
+                    share.finished.push_back(i);
+                    addRow(share.delta.data(), view.allocationRow(i), view.stride);
+                } else {
+                    share.kept.push_back(i);
+                }
+            }
+            evaluated.arrive_and_wait();
+
+            for (int j = columnBegin; j < columnEnd; ++j) {
+                int sum = 0;
+                for (Share& other : shares) {
+                    sum += other.delta[j];
+                    other.delta[j] = 0;
+                }
+                work[j] += sum;
+            }
+            reduced.arrive_and_wait();
+            if (done) return;
+        }
+    };
+
+    std::latch helpersDone(threads - 1);
+    std::vector<std::function<void()>> batch;
+    for (int t = 1; t < threads; ++t) {
+        batch.push_back([&, t]() {
+            worker(t);
+            helpersDone.count_down();
+        });
+    }
+    helpers.postBatch(std::move(batch));
+    worker(0);
+    helpersDone.wait();
+
+    if (stalled) {
+        return finishWithNeedQueues(view, remaining, work, sequence);
+    }
+    return safe;
+}
+
+// Slack tree for a safe sequence of rows (see SlackTree)
+void buildSlackTree(const SafetyView& view, const std::vector<int>& sequence, SlackTree& tree) {
+    std::vector<int> slack(sequence.size() * view.stride);
+    std::vector<int> work(view.available, view.available + view.stride);
+    for (size_t k = 0; k < sequence.size(); ++k) {
+        int* stepSlack = slack.data() + k * view.stride;
+        std::copy(work.begin(), work.end(), stepSlack);
+        subRow(stepSlack, view.needRow(sequence[k]), view.stride);
+        addRow(work.data(), view.allocationRow(sequence[k]), view.stride);
+    }
+    tree.build(slack, static_cast<int>(sequence.size()), view.stride);
+}
+
+// Copy of what a full safety check reads, taken under bankMutex with the
+// grant already applied, so the check itself can run without the lock
+struct OptimisticCheck {
+    uint64_t grantVersion = 0;
+    uint64_t releaseVersion = 0;
+    bool buildTree = false;              // settings copied under the lock
+    std::shared_ptr<ThreadPool> helpers; // null: sequential check
+    std::vector<int> ids;                // process id of each copied row
+    std::vector<int> available;
+    std::vector<int> need;
+    std::vector<int> allocation;
+    bool safe = false;
+    std::vector<int> sequence;           // copied rows in safe order
+    SlackTree tree;
+};
+
+// ==================== Asynchronous Logger ====================
+
+enum class LogLevel {
+    Off = 0,
+    Decisions = 1,   // grants, rejections, releases
+    All = 2          // also request lines and waits
+};
+
+enum class LogEvent {
+    Request,
+    Granted,
+    Waiting,
+    RejectedFinished,
+    RejectedNeed,
+    RejectedUnsafe,
+    RejectedUnavailable,
+    GaveUp,
+    Release,
+    Released,
+    PartiallyReleased,
+    AlreadyFinished,
+    Registered,
+    Unregistered,
+    CapacityAdded
+};
+
+// Fixed-size event so producers never allocate; vectors longer than
+// MAX_VALUES are logged truncated
+struct LogRecord {
+    static constexpr int MAX_VALUES = 8;
+
+    uint64_t sequence = 0;
+    LogEvent event = LogEvent::Request;
+    int processId = 0;
+    int attempt = 0;
+    int maxAttempts = 0;
+    int count = 0;
+    int values[MAX_VALUES] = {};
+
+    void setValues(const int* data, int n) {
+        count = n;
+        std::copy(data, data + std::min(n, MAX_VALUES), values);
+    }
+};
+
+// Single-producer single-consumer ring, one per thread and logger
+class LogRing {
+public:
+    static constexpr size_t CAPACITY = 4096;
+
+    // Returns the number of records queued after the push, 0 if dropped
+    size_t push(const LogRecord& record) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t queued = t - head.load(std::memory_order_acquire);
+        if (queued == CAPACITY) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+        slots[t % CAPACITY] = record;
+        tail.store(t + 1, std::memory_order_release);
+        return queued + 1;
+    }
+
+    bool pop(LogRecord& record) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        record = slots[h % CAPACITY];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint64_t droppedCount() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    // Called by the producer thread on exit, after its last push; the
+    // writer frees the ring once it has drained it
+    void retire() { retired.store(true, std::memory_order_release); }
+    bool isRetired() const { return retired.load(std::memory_order_acquire); }
+
+    // Called when the logger is destroyed; the producer forgets the ring
+    void orphan() { orphaned.store(true, std::memory_order_relaxed); }
+    bool isOrphaned() const { return orphaned.load(std::memory_order_relaxed); }
+
+private:
+    std::array<LogRecord, CAPACITY> slots;
+    alignas(64) std::atomic<size_t> head{0};   // advanced by the consumer
+    alignas(64) std::atomic<size_t> tail{0};   // advanced by the producer
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> retired{false};
+    std::atomic<bool> orphaned{false};
+};
+
+// Threads push events into their own ring without locks or I/O; a
+// background thread formats and writes them. Events are sorted by
+// sequence within each drained batch only: an event whose thread was
+// preempted between taking its number and pushing it can appear after
+// later ones. A full ring drops the event and counts it instead of
+// blocking. A ring is freed once its thread has exited and the writer has
+// drained it. In synchronous mode events are formatted and written on the
+// calling thread under a mutex, the way console output used to work.
+class AsyncLogger {
+public:
+    explicit AsyncLogger(std::ostream& output, LogLevel logLevel = LogLevel::All, bool synchronous = false)
+        : out(output), level(static_cast<int>(logLevel)), sync(synchronous), id(nextLoggerId++) {
+        if (!sync) {
+            writer = std::thread(&AsyncLogger::run, this);
+        }
+    }
+
+    ~AsyncLogger() {
+        if (!sync) {
+            {
+                std::lock_guard<std::mutex> lock(writerMutex);
+                stopping = true;
+            }
+            writerCv.notify_all();
+            writer.join();
+        }
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (const auto& ring : rings) ring->orphan();
+    }
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    bool enabled(LogLevel eventLevel) const {
+        return static_cast<int>(eventLevel) <= level.load(std::memory_order_relaxed);
+    }
+
+    void setLevel(LogLevel logLevel) {
+        level.store(static_cast<int>(logLevel), std::memory_order_relaxed);
+    }
+
+    void log(LogLevel eventLevel, LogRecord record) {
+        if (!enabled(eventLevel)) return;
+        record.sequence = nextSequence.fetch_add(1, std::memory_order_relaxed);
+        if (sync) {
+            std::lock_guard<std::mutex> lock(syncMutex);
+            write(record);
+            written++;
+            return;
+        }
+        // The writer polls every millisecond; a ring filling up wakes it early
+        if (localRing().push(record) == LogRing::CAPACITY / 2) {
+            wakeWriter.store(true, std::memory_order_relaxed);
+            writerCv.notify_one();
+        }
+    }
+
+    // Returns once every event logged before the call has been written
+    void flush() {
+        if (sync) {
+            std::lock_guard<std::mutex> lock(syncMutex);
+            out.flush();
+            return;
+        }
+        std::unique_lock<std::mutex> lock(writerMutex);
+        uint64_t ticket = ++flushRequested;
+        writerCv.notify_all();
+        flushedCv.wait(lock, [&]() { return flushServed >= ticket; });
+    }
+
+    uint64_t droppedCount() {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        uint64_t total = retiredDropped;
+        for (const auto& ring : rings) total += ring->droppedCount();
+        return total;
+    }
+
+    uint64_t writtenCount() const {
+        return written.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::ostream& out;
+    std::atomic<int> level;
+    const bool sync;
+    const uint64_t id;
+    std::atomic<uint64_t> nextSequence{0};
+    std::atomic<uint64_t> written{0};
+    std::mutex syncMutex;
+
+    std::mutex ringsMutex;
+    std::vector<std::shared_ptr<LogRing>> rings;
+    uint64_t retiredDropped = 0;    // drops counted by rings already freed
+
+    std::thread writer;
+    std::mutex writerMutex;
+    std::condition_variable writerCv;
+    std::condition_variable flushedCv;
+    bool stopping = false;
+    std::atomic<bool> wakeWriter{false};
+    uint64_t flushRequested = 0;
+    uint64_t flushServed = 0;
+
+    static inline std::atomic<uint64_t> nextLoggerId{0};
+
+    // Per-thread rings keyed by logger id, shared with the logger. The
+    // thread retires them when it exits
+    struct RingCache {
+        std::vector<std::pair<uint64_t, std::shared_ptr<LogRing>>> entries;
+        ~RingCache() {
+            for (const auto& entry : entries) entry.second->retire();
+        }
+    };
+
+    // A thread registers once per logger; rings of destroyed loggers are
+    // dropped when it registers with a new one
+    LogRing& localRing() {
+        thread_local RingCache cache;
+        for (const auto& entry : cache.entries) {
+            if (entry.first == id) return *entry.second;
+        }
+        std::erase_if(cache.entries, [](const auto& entry) { return entry.second->isOrphaned(); });
+        auto ring = std::make_shared<LogRing>();
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            rings.push_back(ring);
+        }
+        cache.entries.emplace_back(id, ring);
+        return *ring;
+    }
+
+    void run() {
+        std::vector<LogRecord> batch;
+        std::unique_lock<std::mutex> lock(writerMutex);
+        while (true) {
+            uint64_t ticket = flushRequested;
+            bool stop = stopping;
+            wakeWriter.store(false, std::memory_order_relaxed);
+            lock.unlock();
+
+            batch.clear();
+            {
+                std::lock_guard<std::mutex> ringsLock(ringsMutex);
+                LogRecord record;
+                for (size_t r = 0; r < rings.size(); ) {
+                    // Read before draining, so the exited thread's
+                    // last pushes are seen
+                    bool retired = rings[r]->isRetired();
+                    while (rings[r]->pop(record)) batch.push_back(record);
+                    if (retired) {
+                        retiredDropped += rings[r]->droppedCount();
+                        rings[r] = std::move(rings.back());
+                        rings.pop_back();
+                    } else {
+                        ++r;
+                    }
+                }
+            }
+            std::sort(batch.begin(), batch.end(),
+                      [](const LogRecord& a, const LogRecord& b) { return a.sequence < b.sequence; });
+            for (const LogRecord& record : batch) {
+                write(record);
+            }
+            written.fetch_add(batch.size(), std::memory_order_relaxed);
+            if (!batch.empty() || ticket > 0) out.flush();
+
+            lock.lock();
+            flushServed = ticket;
+            flushedCv.notify_all();
+            if (stop) return;
+            if (batch.empty()) {
+                writerCv.wait_for(lock, std::chrono::milliseconds(1),
+                                  [&]() {
+                                      return stopping || flushRequested != ticket ||
+                                             wakeWriter.load(std::memory_order_relaxed);
+                                  });
+            }
+        }
+    }
+
+    void writeValues(const LogRecord& record) {
+        out << "[";
+        for (int i = 0; i < std::min(record.count, LogRecord::MAX_VALUES); ++i) {
+            out << record.values[i];
+            if (i < record.count - 1) out << ", ";
+        }
+        if (record.count > LogRecord::MAX_VALUES) out << "...";
+        out << "]\n";
+    }
+
+    void write(const LogRecord& record) {
+        const int pid = record.processId;
+        switch (record.event) {
+        case LogEvent::Request:
+            out << "\n[P" << pid << "] Запрос ресурсов";
+            if (record.attempt > 1) {
+                out << " (попытка " << record.attempt << "/" << record.maxAttempts << ")";
+            }
+            out << ": ";
+            writeValues(record);
+            break;
+        case LogEvent::Granted:
+            out << "[P" << pid << "] ✓ ВЫДЕЛЕНО: состояние безопасно\n";
+            break;
+        case LogEvent::Waiting:
+            out << "[P" << pid << "] ⏳ ОЖИДАНИЕ: недостаточно доступных ресурсов\n";
+            break;
+        case LogEvent::RejectedFinished:
+            out << "[P" << pid << "] ✗ ОТКЛОНЕНО: процесс уже завершён\n";
+            break;
+        case LogEvent::RejectedNeed:
+            out << "[P" << pid << "] ✗ ОТКЛОНЕНО: запрос превышает заявленную потребность\n";
+            break;
+        case LogEvent::RejectedUnsafe:
+            out << "[P" << pid << "] ✗ ОТКЛОНЕНО: приведет к небезопасному состоянию\n";
+            break;
+        case LogEvent::RejectedUnavailable:
+            out << "[P" << pid << "] ✗ ОТКЛОНЕНО: недостаточно доступных ресурсов\n";
+            break;
+        case LogEvent::GaveUp:
+            out << "[P" << pid << "] ✗ ОТКАЗ: превышено максимальное число попыток\n";
+            break;
+        case LogEvent::Release:
+            out << "\n[P" << pid << "] Освобождение ресурсов: ";
+            writeValues(record);
+            break;
+        case LogEvent::Released:
+            out << "[P" << pid << "] ✓ Ресурсы освобождены, процесс завершён\n";
+            break;
+        case LogEvent::PartiallyReleased:
+            out << "[P" << pid << "] ✓ Часть ресурсов освобождена\n";
+            break;
+        case LogEvent::AlreadyFinished:
+            out << "[P" << pid << "] ⚠ Процесс уже завершён\n";
+            break;
+        case LogEvent::Registered:
+            out << "\n[P" << pid << "] Зарегистрирован, максимальная потребность: ";
+            writeValues(record);
+            break;
+        case LogEvent::Unregistered:
+            out << "[P" << pid << "] Снят с учёта, слот свободен\n";
+            break;
+        case LogEvent::CapacityAdded:
+            out << "\nПополнение ресурсов: ";
+            writeValues(record);
+            break;
+        }
+    }
+};
+
+// Console logger shared by banks that are not given their own
+AsyncLogger& consoleLogger() {
+    static AsyncLogger logger(std::cout);
+    return logger;
+}
+
+// ==================== Metrics ====================
+
+// Compile with -DBANKER_ENABLE_METRICS to record lock, safety-check and
+// request metrics. Without it every recording site compiles away
+#if defined(BANKER_ENABLE_METRICS)
+constexpr bool METRICS_ENABLED = true;
+#else
+constexpr bool METRICS_ENABLED = false;
+#endif
+
+using MetricsClock = std::chrono::steady_clock;
+
+inline uint64_t nanosecondsBetween(MetricsClock::time_point from, MetricsClock::time_point to) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+}
+
+struct HistogramSnapshot {
+    static constexpr int BUCKETS = 40;
+
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    std::array<uint64_t, BUCKETS> buckets{};
+
+    // Bucket b counts values v with bit_width(v) == b, i.e. [2^(b-1), 2^b)
+    static uint64_t upperBound(int b) {
+        return b == 0 ? 0 : (uint64_t{1} << b) - 1;
+    }
+
+    double mean() const {
+        return count == 0 ? 0.0 : static_cast<double>(sum) / count;
+    }
+
+    // Upper bound of the bucket holding the share-th value
+    uint64_t quantile(double share) const {
+        uint64_t rank = static_cast<uint64_t>(share * count);
+        uint64_t seen = 0;
+        for (int b = 0; b < BUCKETS; ++b) {
+            seen += buckets[b];
+            if (seen > rank) return upperBound(b);
+        }
+        return upperBound(BUCKETS - 1);
+    }
+
+    void writeJson(std::ostream& out) const {
+        out << "{\"count\": " << count << ", \"sum\": " << sum << ", \"mean\": " << mean()
+            << ", \"p50\": " << quantile(0.5) << ", \"p99\": " << quantile(0.99) << ", \"buckets\": [";
+        bool first = true;
+        for (int b = 0; b < BUCKETS; ++b) {
+            if (buckets[b] == 0) continue;
+            out << (first ? "" : ", ") << "[" << upperBound(b) << ", " << buckets[b] << "]";
+            first = false;
+        }
+        out << "]}";
+    }
+};
+
+// Power-of-two histogram any thread can record into without a lock
+class Log2Histogram {
+public:
+    void record(uint64_t value) {
+        if constexpr (METRICS_ENABLED) {
+            int b = std::min(static_cast<int>(std::bit_width(value)), HistogramSnapshot::BUCKETS - 1);
+            buckets[b].fetch_add(1, std::memory_order_relaxed);
+            count.fetch_add(1, std::memory_order_relaxed);
+            sum.fetch_add(value, std::memory_order_relaxed);
+        }
+    }
+
+    HistogramSnapshot snapshot() const {
+        HistogramSnapshot result;
+        result.count = count.load(std::memory_order_relaxed);
+        result.sum = sum.load(std::memory_order_relaxed);
+        for (int b = 0; b < HistogramSnapshot::BUCKETS; ++b) {
+            result.buckets[b] = buckets[b].load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, HistogramSnapshot::BUCKETS> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+};
 
 // ==================== Banker's Algorithm Class ====================
+
+// Outcome of a single non-blocking allocation attempt
+enum class GrantResult {
+    Granted,
+    ProcessFinished,
+    ExceedsNeed,
+    Unavailable,
+    Unsafe
+};
+
+struct SafetyStats {
+    long long incrementalChecks = 0;   // grants confirmed against the last safe sequence
+    long long fullChecks = 0;          // grants that needed findSafeSequence
+    long long optimisticChecks = 0;    // full checks run outside bankMutex
+    long long optimisticConflicts = 0; // of those, discarded because a grant moved the state
+};
+
+struct WaitStats {
+    long long waits = 0;          // requesters parked in the wait queue
+    long long wakeups = 0;        // waiters woken by a release
+    long long futileWakeups = 0;  // woken waiters whose next attempt still failed
+    long long timeouts = 0;       // waits that ended without a wakeup
+    long long parked = 0;         // asynchronous requests parked in the bank
+    long long resumed = 0;        // parked requests completed by a release
+};
+
+// Live metrics of one bank; see METRICS_ENABLED
+struct BankMetrics {
+    Log2Histogram lockWaitNs;             // taking bankMutex on request and release paths
+    Log2Histogram lockHoldNs;             // holding it there, waits on condition variables excluded
+    Log2Histogram safetyCheckNs;          // full safety checks, under the lock or on a snapshot
+    Log2Histogram safetyCheckProcesses;   // processes each full check had to order
+    std::array<std::atomic<uint64_t>, 5> outcomes{};   // grant attempts by GrantResult
+    std::atomic<uint64_t> retries{0};     // requestResources attempts after the first
+};
+
+// Copy of a bank's metrics and counters at one moment
+struct MetricsSnapshot {
+    bool enabled = METRICS_ENABLED;
+    HistogramSnapshot lockWaitNs;
+    HistogramSnapshot lockHoldNs;
+    HistogramSnapshot safetyCheckNs;
+    HistogramSnapshot safetyCheckProcesses;
+    std::array<uint64_t, 5> outcomes{};   // indexed by GrantResult
+    uint64_t retries = 0;
+    SafetyStats safety;
+    WaitStats waits;
+
+    std::string toJson() const {
+        std::ostringstream out;
+        out << "{\n  \"enabled\": " << (enabled ? "true" : "false") << ",\n  \"lock_wait_ns\": ";
+        lockWaitNs.writeJson(out);
+        out << ",\n  \"lock_hold_ns\": ";
+        lockHoldNs.writeJson(out);
+        out << ",\n  \"safety_check_ns\": ";
+        safetyCheckNs.writeJson(out);
+        out << ",\n  \"safety_check_processes\": ";
+        safetyCheckProcesses.writeJson(out);
+        out << ",\n  \"grant_attempts\": {\"granted\": " << outcomes[0] << ", \"process_finished\": " << outcomes[1]
+            << ", \"exceeds_need\": " << outcomes[2] << ", \"unavailable\": " << outcomes[3]
+            << ", \"unsafe\": " << outcomes[4] << ", \"retries\": " << retries << "}"
+            << ",\n  \"safety_checks\": {\"incremental\": " << safety.incrementalChecks
+            << ", \"full\": " << safety.fullChecks << ", \"optimistic\": " << safety.optimisticChecks
+            << ", \"optimistic_conflicts\": " << safety.optimisticConflicts << "}"
+            << ",\n  \"waits\": {\"waits\": " << waits.waits << ", \"wakeups\": " << waits.wakeups
+            << ", \"futile_wakeups\": " << waits.futileWakeups << ", \"timeouts\": " << waits.timeouts
+            << ", \"parked\": " << waits.parked << ", \"resumed\": " << waits.resumed << "}\n}";
+        return out.str();
+    }
+};
+
+// Where completions of asynchronous requests run; ThreadPool::post fits
+using Executor = std::function<void(std::function<void()>)>;
+
+// One entry of a batch passed to grantBatch
+struct PendingRequest {
+    int processId;
+    std::vector<int> request;
+    int priority = 0;   // larger goes first under AdmissionPolicy::Priority
+};
+
+enum class AdmissionPolicy {
+    Fifo,            // batch order
+    SmallestFirst,   // fewest total units first
+    Priority         // highest priority first
+};
+
+// true if a should be considered before b
+using AdmissionOrder = std::function<bool(const PendingRequest&, const PendingRequest&)>;
+
+AdmissionOrder admissionOrder(AdmissionPolicy policy) {
+    switch (policy) {
+    case AdmissionPolicy::SmallestFirst:
+        return [](const PendingRequest& a, const PendingRequest& b) {
+            auto units = [](const PendingRequest& r) {
+                long long sum = 0;
+                for (int v : r.request) sum += v;
+                return sum;
+            };
+            return units(a) < units(b);
+        };
+    case AdmissionPolicy::Priority:
+        return [](const PendingRequest& a, const PendingRequest& b) { return a.priority > b.priority; };
+    case AdmissionPolicy::Fifo:
+        break;
+    }
+    return [](const PendingRequest&, const PendingRequest&) { return false; };
+}
+
 class BankersAlgorithm {
 private:
-    int numProcesses;
+    int numProcesses;               // slots, including finished and free ones; never shrinks
     int numResources;
-    std::vector<int> available;
-    std::vector<std::vector<int>> maximum;
-    std::vector<std::vector<int>> allocation;
-    std::vector<std::vector<int>> need;
+    int stride;                     // ints per matrix row (numResources rounded up to SIMD_WIDTH)
+    std::vector<int> available;     // stride ints, padding lanes are 0
+    std::vector<int> maximum;       // numProcesses x stride, row-major
+    std::vector<int> allocation;
+    std::vector<int> need;
+    std::vector<int> total;         // available + all allocations, grows with addResourceCapacity
     std::mutex bankMutex;
-    std::condition_variable cv;
-    std::vector<bool> finished;
+    std::vector<bool> finished;     // also true for free slots
+    std::vector<int> activeList;    // unfinished processes in increasing order
+    std::set<int> freeSlots;        // unregistered slots, reused lowest first
+    std::vector<uint64_t> slotGeneration;   // bumped when a slot is unregistered, so a
+                                            // requester that slept can tell its process was replaced
     std::mutex printMutex;
+    AsyncLogger* logger = &consoleLogger();   // nullptr logs nothing
+
+    // Last safe sequence found by a full check. Grants and releases keep it
+    // current, so most grants only need an O(m·log n) check of its prefix
+    bool incrementalEnabled = true;
+    bool sequenceValid = false;
+    std::vector<int> sequencePosition;   // step of each process, -1 if absent
+    SlackTree slackTree;
+    SafetyStats safetyStats;
+
+    // Full safety checks run on a snapshot outside bankMutex when another
+    // requester is inside the bank. grantVersion moves on every grant;
+    // releaseVersion on every release, which can only make a state safer,
+    // so a snapshot verdict of "safe" survives releases
+    bool optimisticEnabled = true;
+    std::atomic<int> requestersInside{0};
+    uint64_t grantVersion = 0;
+    uint64_t releaseVersion = 0;
+    static constexpr int OPTIMISTIC_ATTEMPTS = 3;
+
+    // Requesters blocked until a release, in arrival order. Each waits on its
+    // own condition variable, so a release wakes only the waiters it helps
+    struct Waiter {
+        int processId;
+        const int* request;
+        std::condition_variable cv;
+        bool woken = false;
+    };
+    std::vector<Waiter*> waitQueue;
+    bool targetedWakeups = true;
+    WaitStats waitStats;
+
+    // Asynchronous requests waiting for a release, in arrival order. Their
+    // completions run through executor once bankMutex is released; without
+    // one they run on the releasing thread
+    struct ParkedRequest {
+        int processId;
+        uint64_t generation;        // slotGeneration of processId when parked
+        std::vector<int> request;   // padded
+        std::function<void(GrantResult)> complete;
+    };
+    std::vector<ParkedRequest> parked;
+    Executor executor;
+
+    // Recorded only when METRICS_ENABLED; mutable because const safety
+    // checks are timed too
+    mutable BankMetrics metrics;
+
+    // Full checks over at least parallelMinProcesses candidates use
+    // computeSafeSequenceParallel on these helpers; off by default. Shared
+    // so a snapshot check keeps its helpers if the setting changes
+    std::shared_ptr<ThreadPool> safetyHelpers;
+    size_t parallelMinProcesses = std::numeric_limits<size_t>::max();
+
+    int* row(std::vector<int>& matrix, int i) {
+        return matrix.data() + static_cast<size_t>(i) * stride;
+    }
+    const int* row(const std::vector<int>& matrix, int i) const {
+        return matrix.data() + static_cast<size_t>(i) * stride;
+    }
+
+    SafetyView view() const {
+        return {numProcesses, numResources, stride, available.data(), need.data(), allocation.data()};
+    }
+
+    // ИСПРАВЛЕНИЕ: Пропускаем завершённые процессы. The list is kept up to
+    // date, so dead rows cost nothing here
+    std::vector<int> activeProcesses() const {
+        return activeList;
+    }
+
+    // Copy a request into a zero-padded vector the kernels can read
+    std::vector<int> padded(const std::vector<int>& v) const {
+        if (static_cast<int>(v.size()) != numResources) {
+            throw std::invalid_argument("Ошибка: Длина запроса не совпадает с числом ресурсов");
+        }
+        std::vector<int> result(stride, 0);
+        std::copy(v.begin(), v.end(), result.begin());
+        return result;
+    }
 
 public:
     BankersAlgorithm(int processes, int resources,
@@ -31,33 +1192,52 @@ public:
                      const std::vector<std::vector<int>>& alloc)
         : numProcesses(processes),
           numResources(resources),
-          available(avail),
-          maximum(max),
-          allocation(alloc),
-          finished(processes, false)
+          stride(paddedWidth(resources)),
+          maximum(static_cast<size_t>(processes) * stride, 0),
+          allocation(static_cast<size_t>(processes) * stride, 0),
+          need(static_cast<size_t>(processes) * stride, 0),
+          finished(processes, false),
+          slotGeneration(processes, 0)
     {
+        if (static_cast<int>(max.size()) != numProcesses ||
+            static_cast<int>(alloc.size()) != numProcesses) {
+            throw std::invalid_argument("Ошибка: Число строк матриц не совпадает с числом процессов");
+        }
+        available = padded(avail);
+        for (int i = 0; i < numProcesses; ++i) {
+            if (static_cast<int>(max[i].size()) != numResources ||
+                static_cast<int>(alloc[i].size()) != numResources) {
+                throw std::invalid_argument("Ошибка: Неверная длина строки процесса P" + std::to_string(i));
+            }
+            std::copy(max[i].begin(), max[i].end(), row(maximum, i));
+            std::copy(alloc[i].begin(), alloc[i].end(), row(allocation, i));
+        }
+
         // Validate input data
         validateInitialState();
 
         // Calculate need matrix: Need = Maximum - Allocation
-        need.resize(numProcesses, std::vector<int>(numResources));
+        total = available;
         for (int i = 0; i < numProcesses; ++i) {
-            for (int j = 0; j < numResources; ++j) {
-                need[i][j] = maximum[i][j] - allocation[i][j];
-            }
+            std::copy(row(maximum, i), row(maximum, i) + stride, row(need, i));
+            subRow(row(need, i), row(allocation, i), stride);
+            addRow(total.data(), row(allocation, i), stride);
+            activeList.push_back(i);
         }
     }
 
     // Validate initial configuration
     void validateInitialState() {
         for (int i = 0; i < numProcesses; ++i) {
+            const int* maxRow = row(maximum, i);
+            const int* allocRow = row(allocation, i);
             for (int j = 0; j < numResources; ++j) {
-                if (allocation[i][j] > maximum[i][j]) {
+                if (allocRow[j] > maxRow[j]) {
                     throw std::invalid_argument(
                         "Ошибка: Allocation[" + std::to_string(i) + "][" + 
                         std::to_string(j) + "] > Maximum");
                 }
-                if (allocation[i][j] < 0 || maximum[i][j] < 0) {
+                if (allocRow[j] < 0 || maxRow[j] < 0) {
                     throw std::invalid_argument("Ошибка: Отрицательные значения недопустимы");
                 }
             }
@@ -67,7 +1247,7 @@ public:
         for (int j = 0; j < numResources; ++j) {
             int sum = available[j];
             for (int i = 0; i < numProcesses; ++i) {
-                sum += allocation[i][j];
+                sum += row(allocation, i)[j];
             }
             if (sum < 0) {
                 throw std::invalid_argument(
@@ -77,58 +1257,19 @@ public:
     }
 
     // Check if request can be granted (safety algorithm)
-    bool isSafe() {
-        std::vector<int> work = available;
-        std::vector<bool> finish(numProcesses, false);
-        std::vector<int> safeSequence;
-        int count = 0;
-
-        while (count < numProcesses) {
-            bool found = false;
-            for (int i = 0; i < numProcesses; ++i) {
-                // ИСПРАВЛЕНИЕ: Пропускаем завершённые процессы
-                if (!finish[i] && !finished[i]) {
-                    // Check if process i can be allocated
-                    bool canAllocate = true;
-                    for (int j = 0; j < numResources; ++j) {
-                        if (need[i][j] > work[j]) {
-                            canAllocate = false;
-                            break;
-                        }
-                    }
-
-                    if (canAllocate) {
-                        // Process i can finish, release its resources
-                        for (int j = 0; j < numResources; ++j) {
-                            work[j] += allocation[i][j];
-                        }
-                        finish[i] = true;
-                        safeSequence.push_back(i);
-                        found = true;
-                        count++;
-                    }
-                }
-            }
+    bool isSafe() const {
+        std::vector<int> sequence;
+        return findSafeSequence(sequence);
+    }
 
-            if (!found) {
-                // Check if all remaining processes are finished
-                bool allFinished = true;
-                for (int i = 0; i < numProcesses; ++i) {
-                    if (!finish[i] && !finished[i]) {
-                        allFinished = false;
-                        break;
-                    }
-                }
-                if (allFinished) {
-                    return true;
-                }
-                return false;
-            }
-        }
-        return true;
+    // Safety algorithm over the unfinished processes, see computeSafeSequence
+    bool findSafeSequence(std::vector<int>& sequence) const {
+        return runSafetyCheck(view(), activeProcesses(), sequence);
     }
 
-    bool findSafeSequence(std::vector<int>& sequence) {
+    // Original round-based scan, kept as the reference for benchmarks and
+    // cross-checks: every round walks all unfinished processes
+    bool findSafeSequenceScan(std::vector<int>& sequence) const {
         std::vector<int> work = available;
         std::vector<bool> finish(numProcesses, false);
         sequence.clear();
@@ -138,18 +1279,8 @@ public:
             bool found = false;
             for (int i = 0; i < numProcesses; ++i) {
                 if (!finish[i] && !finished[i]) {
-                    bool canAllocate = true;
-                    for (int j = 0; j < numResources; ++j) {
-                        if (need[i][j] > work[j]) {
-                            canAllocate = false;
-                            break;
-                        }
-                    }
-
-                    if (canAllocate) {
-                        for (int j = 0; j < numResources; ++j) {
-                            work[j] += allocation[i][j];
-                        }
+                    if (rowLessEqual(row(need, i), work.data(), stride)) {
+                        addRow(work.data(), row(allocation, i), stride);
                         finish[i] = true;
                         sequence.push_back(i);
                         found = true;
@@ -173,175 +1304,447 @@ public:
                 return false;
             }
         }
-        return true;
+        return true;
+    }
+
+    // True if the processes in sequence can finish in that order and the
+    // sequence covers every unfinished process
+    bool replaysSafely(const std::vector<int>& sequence) const {
+        std::vector<int> work = available;
+        std::vector<bool> seen(numProcesses, false);
+        for (int i : sequence) {
+            if (i < 0 || i >= numProcesses || finished[i] || seen[i]) return false;
+            if (!rowLessEqual(row(need, i), work.data(), stride)) return false;
+            addRow(work.data(), row(allocation, i), stride);
+            seen[i] = true;
+        }
+        return sequence.size() == activeList.size();
+    }
+
+    // Single allocation attempt without waiting or console output
+    GrantResult tryRequestResources(int processId, const std::vector<int>& request) {
+        const std::vector<int> req = padded(request);
+        RequesterScope scope(requestersInside);
+        BankLock lock(*this);
+        checkProcessId(processId);
+        return tryGrant(processId, req.data(), lock);
     }
 
     // Request resources with retry mechanism
     bool requestResources(int processId, const std::vector<int>& request, 
                          int maxRetries = 5, int timeoutMs = 1000) {
-        // Don't allow requests from finished processes
-        if (finished[processId]) {
-            std::lock_guard<std::mutex> printLock(printMutex);
-            std::cout << "[P" << processId << "] ✗ ОТКЛОНЕНО: процесс уже завершён\n";
-            return false;
-        }
-
+        const std::vector<int> req = padded(request);
+        RequesterScope scope(requestersInside);
         int retries = 0;
+        bool woken = false;
+        std::optional<uint64_t> generation;   // slot generation seen on entry
 
         while (retries < maxRetries) {
-            std::unique_lock<std::mutex> lock(bankMutex);
-
-            {
-                std::lock_guard<std::mutex> printLock(printMutex);
-                std::cout << "\n[P" << processId << "] Запрос ресурсов";
-                if (retries > 0) {
-                    std::cout << " (попытка " << (retries + 1) << "/" << maxRetries << ")";
-                }
-                std::cout << ": ";
-                printVector(request);
-            }
-
-            // Check if request exceeds need
-            bool exceedsNeed = false;
-            for (int j = 0; j < numResources; ++j) {
-                if (request[j] > need[processId][j]) {
-                    exceedsNeed = true;
-                    break;
-                }
-            }
-
-            if (exceedsNeed) {
-                std::lock_guard<std::mutex> printLock(printMutex);
-                std::cout << "[P" << processId << "] ✗ ОТКЛОНЕНО: запрос превышает заявленную потребность\n";
+            BankLock lock(*this);
+            checkProcessId(processId);
+            if (!generation) generation = slotGeneration[processId];
+
+            // Don't allow requests from finished processes, or from one whose
+            // slot was unregistered and reused while this request waited
+            if (finished[processId] || slotGeneration[processId] != *generation) {
+                countOutcome(GrantResult::ProcessFinished);
+                report(LogLevel::Decisions, LogEvent::RejectedFinished, processId);
                 return false;
             }
 
-            // Check if resources are available
-            bool resourcesAvailable = true;
-            for (int j = 0; j < numResources; ++j) {
-                if (request[j] > available[j]) {
-                    resourcesAvailable = false;
-                    break;
-                }
+            if constexpr (METRICS_ENABLED) {
+                if (retries > 0) metrics.retries.fetch_add(1, std::memory_order_relaxed);
             }
+            report(LogLevel::All, LogEvent::Request, processId, req.data(), retries + 1, maxRetries);
 
-            if (!resourcesAvailable) {
-                std::lock_guard<std::mutex> printLock(printMutex);
-                std::cout << "[P" << processId << "] ⏳ ОЖИДАНИЕ: недостаточно доступных ресурсов\n";
-
-                // Wait with timeout
-                bool signaled = cv.wait_for(lock, std::chrono::milliseconds(timeoutMs),
-                    [&]() {
-                        for (int k = 0; k < numResources; ++k) {
-                            if (request[k] > available[k]) return false;
-                        }
-                        return true;
-                    });
-
-                if (!signaled) {
-                    retries++;
-                    continue;
-                }
+            GrantResult result = tryGrant(processId, req.data(), lock);
+            if (woken && result != GrantResult::Granted) waitStats.futileWakeups++;
+            woken = false;
 
-                // Recheck availability after wake up
-                resourcesAvailable = true;
-                for (int j = 0; j < numResources; ++j) {
-                    if (request[j] > available[j]) {
-                        resourcesAvailable = false;
-                        break;
-                    }
-                }
+            if (result == GrantResult::Unavailable) {
+                report(LogLevel::All, LogEvent::Waiting, processId);
 
-                if (!resourcesAvailable) {
+                // Wait with timeout
+                if (!waitForRelease(lock, processId, req.data(), timeoutMs)) {
                     retries++;
                     continue;
                 }
-            }
+                if (slotGeneration[processId] != *generation) continue;
+                result = tryGrant(processId, req.data(), lock);
+                if (result != GrantResult::Granted) waitStats.futileWakeups++;
 
-            // Temporarily allocate resources
-            for (int j = 0; j < numResources; ++j) {
-                available[j] -= request[j];
-                allocation[processId][j] += request[j];
-                need[processId][j] -= request[j];
+                // Another requester took the units first: wait again, this
+                // neither counts as a retry nor as an unsafe state
+                if (result == GrantResult::Unavailable) continue;
             }
 
-            // Check if state is safe
-            if (isSafe()) {
-                std::lock_guard<std::mutex> printLock(printMutex);
-                std::cout << "[P" << processId << "] ✓ ВЫДЕЛЕНО: состояние безопасно\n";
+            if (result == GrantResult::Granted) {
+                report(LogLevel::Decisions, LogEvent::Granted, processId);
                 return true;
-            } else {
-                // Rollback allocation
-                for (int j = 0; j < numResources; ++j) {
-                    available[j] += request[j];
-                    allocation[processId][j] -= request[j];
-                    need[processId][j] += request[j];
-                }
+            }
+            if (result == GrantResult::ExceedsNeed) {
+                report(LogLevel::Decisions, LogEvent::RejectedNeed, processId);
+                return false;
+            }
+            if (result == GrantResult::ProcessFinished) {
+                report(LogLevel::Decisions, LogEvent::RejectedFinished, processId);
+                return false;
+            }
 
-                {
-                    std::lock_guard<std::mutex> printLock(printMutex);
-                    std::cout << "[P" << processId << "] ✗ ОТКЛОНЕНО: приведет к небезопасному состоянию\n";
-                }
+            report(LogLevel::Decisions, LogEvent::RejectedUnsafe, processId);
 
-                // Wait before retry
-                cv.wait_for(lock, std::chrono::milliseconds(timeoutMs));
-                retries++;
-            }
+            // Wait before retry
+            woken = waitForRelease(lock, processId, req.data(), timeoutMs);
+            retries++;
         }
 
         // Max retries exceeded
-        std::lock_guard<std::mutex> printLock(printMutex);
-        std::cout << "[P" << processId << "] ✗ ОТКАЗ: превышено максимальное число попыток\n";
+        report(LogLevel::Decisions, LogEvent::GaveUp, processId);
         return false;
     }
 
     // ИСПРАВЛЕНИЕ: Всегда завершаем процесс при освобождении ресурсов
     void releaseResources(int processId) {
-        std::unique_lock<std::mutex> lock(bankMutex);
+        BankLock lock(*this);
+        checkProcessId(processId);
 
         if (finished[processId]) {
-            std::lock_guard<std::mutex> printLock(printMutex);
-            std::cout << "[P" << processId << "] ⚠ Процесс уже завершён\n";
+            report(LogLevel::Decisions, LogEvent::AlreadyFinished, processId);
             return;
         }
 
-        {
-            std::lock_guard<std::mutex> printLock(printMutex);
-            std::cout << "\n[P" << processId << "] Освобождение ресурсов: ";
-            printVector(allocation[processId]);
+        report(LogLevel::Decisions, LogEvent::Release, processId, row(allocation, processId));
+        finishProcess(processId);
+        report(LogLevel::Decisions, LogEvent::Released, processId);
+
+        // Notify waiting processes that can now proceed
+        wakeWaiters();
+        resumeParked(lock);
+    }
+
+    // Returns part of a process's allocation without finishing it; its need
+    // grows back by the same amount. Returns false if amounts exceed the
+    // allocation or the process has finished
+    bool releaseResources(int processId, const std::vector<int>& amounts) {
+        const std::vector<int> amount = padded(amounts);
+        BankLock lock(*this);
+        checkProcessId(processId);
+        if (finished[processId] || !rowLessEqual(amount.data(), row(allocation, processId), stride) ||
+            std::any_of(amount.begin(), amount.end(), [](int v) { return v < 0; })) {
+            return false;
         }
+        report(LogLevel::Decisions, LogEvent::Release, processId, amount.data());
 
-        // Release all allocated resources
-        for (int j = 0; j < numResources; ++j) {
-            available[j] += allocation[processId][j];
-            allocation[processId][j] = 0;
-            need[processId][j] = 0; // Process finished - no more needs
+        // Steps before the process gain the units; its own step is unchanged
+        // because its need grows by exactly what work gains
+        if (sequenceValid && sequencePosition[processId] >= 0) {
+            slackTree.addPrefix(sequencePosition[processId], amount.data(), 1);
         }
+        moveToAvailable(processId, amount.data());
+        releaseVersion++;
 
-        finished[processId] = true;
+        report(LogLevel::Decisions, LogEvent::PartiallyReleased, processId);
+        wakeWaiters();
+        resumeParked(lock);
+        return true;
+    }
 
-        {
-            std::lock_guard<std::mutex> printLock(printMutex);
-            std::cout << "[P" << processId << "] ✓ Ресурсы освобождены, процесс завершён\n";
+    std::vector<int> allocationOf(int processId) {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        checkProcessId(processId);
+        return std::vector<int>(row(allocation, processId), row(allocation, processId) + numResources);
+    }
+
+    // Adds a process with the given maximum claim and nothing allocated, in
+    // the lowest free slot or a new one. Returns its id. The remembered safe
+    // sequence stays valid: the new process can always run last, because
+    // its claim fits in the total
+    int registerProcess(const std::vector<int>& maxClaim) {
+        const std::vector<int> claim = padded(maxClaim);
+        if (std::any_of(claim.begin(), claim.end(), [](int v) { return v < 0; })) {
+            throw std::invalid_argument("Ошибка: Отрицательные значения недопустимы");
+        }
+        BankLock lock(*this);
+        if (!rowLessEqual(claim.data(), total.data(), stride)) {
+            throw std::invalid_argument("Ошибка: Максимальная потребность превышает общее число ресурсов");
         }
 
-        // Notify waiting processes
-        cv.notify_all();
+        int processId;
+        if (!freeSlots.empty()) {
+            processId = *freeSlots.begin();
+            freeSlots.erase(freeSlots.begin());
+        } else {
+            processId = numProcesses++;
+            const size_t size = static_cast<size_t>(numProcesses) * stride;
+            maximum.resize(size, 0);
+            allocation.resize(size, 0);
+            need.resize(size, 0);
+            finished.push_back(true);
+            slotGeneration.push_back(0);
+            if (sequenceValid) sequencePosition.push_back(-1);
+        }
+        std::copy(claim.begin(), claim.end(), row(maximum, processId));
+        std::copy(claim.begin(), claim.end(), row(need, processId));
+        finished[processId] = false;
+        activeList.insert(std::lower_bound(activeList.begin(), activeList.end(), processId), processId);
+
+        report(LogLevel::Decisions, LogEvent::Registered, processId, claim.data());
+        return processId;
     }
 
-    // Get number of active (not finished) processes
-    int getActiveProcessCount() const {
-        int count = 0;
+    // Finishes the process if it is still running, returning its allocation,
+    // and frees its slot for registerProcess
+    void unregisterProcess(int processId) {
+        BankLock lock(*this);
+        checkProcessId(processId);
+        if (freeSlots.count(processId) != 0) return;
+
+        bool wasActive = !finished[processId];
+        if (wasActive) {
+            report(LogLevel::Decisions, LogEvent::Release, processId, row(allocation, processId));
+            finishProcess(processId);
+        }
+        std::fill(row(maximum, processId), row(maximum, processId) + stride, 0);
+        freeSlots.insert(processId);
+        slotGeneration[processId]++;
+        report(LogLevel::Decisions, LogEvent::Unregistered, processId);
+        if (wasActive) {
+            wakeWaiters();
+            resumeParked(lock);
+        }
+    }
+
+    // Adds units of one resource type to the pool. Every step of the
+    // remembered sequence gains them, so it stays valid
+    void addResourceCapacity(int resource, int amount) {
+        if (resource < 0 || resource >= numResources) {
+            throw std::out_of_range("Ошибка: Неверный номер ресурса " + std::to_string(resource));
+        }
+        if (amount < 0) {
+            throw std::invalid_argument("Ошибка: Отрицательные значения недопустимы");
+        }
+        std::vector<int> delta(stride, 0);
+        delta[resource] = amount;
+
+        BankLock lock(*this);
+        report(LogLevel::Decisions, LogEvent::CapacityAdded, -1, delta.data());
+        available[resource] += amount;
+        total[resource] += amount;
+        if (sequenceValid) {
+            slackTree.addPrefix(numProcesses, delta.data(), 1);
+        }
+        releaseVersion++;
+        wakeWaiters();
+        resumeParked(lock);
+    }
+
+    // Grants the request now, or parks it in the bank until a release lets
+    // it through. Returns the verdict if it was decided right away, and then
+    // done is never called. Otherwise done runs later, outside bankMutex,
+    // with Granted, ProcessFinished if the process ends first, or
+    // ExceedsNeed if other grants to the process meanwhile left its need
+    // below the request. No thread waits meanwhile
+    std::optional<GrantResult> submitRequest(int processId, const std::vector<int>& request,
+                                             std::function<void(GrantResult)> done) {
+        std::vector<int> req = padded(request);
+        RequesterScope scope(requestersInside);
+        BankLock lock(*this);
+        checkProcessId(processId);
+        report(LogLevel::All, LogEvent::Request, processId, req.data());
+
+        GrantResult result = tryGrant(processId, req.data(), lock);
+        if (result == GrantResult::Unavailable || result == GrantResult::Unsafe) {
+            report(LogLevel::All, LogEvent::Waiting, processId);
+            parked.push_back({processId, slotGeneration[processId], std::move(req), std::move(done)});
+            waitStats.parked++;
+            return std::nullopt;
+        }
+        report(LogLevel::Decisions, outcomeEvent(result), processId);
+        return result;
+    }
+
+    // Non-blocking requestResources: the future becomes ready once the
+    // request is granted or rejected
+    std::future<GrantResult> requestResourcesAsync(int processId, const std::vector<int>& request) {
+        auto promise = std::make_shared<std::promise<GrantResult>>();
+        std::future<GrantResult> result = promise->get_future();
+        std::optional<GrantResult> now =
+            submitRequest(processId, request, [promise](GrantResult r) { promise->set_value(r); });
+        if (now) promise->set_value(*now);
+        return result;
+    }
+
+    // co_await bank.requestResourcesAwaitable(pid, request) suspends the
+    // coroutine while the request is parked and resumes it on the executor
+    struct GrantAwaitable {
+        BankersAlgorithm& bank;
+        int processId;
+        std::vector<int> request;
+        GrantResult result = GrantResult::Granted;
+
+        bool await_ready() const noexcept { return false; }
+
+        // The coroutine may be resumed by a release before this returns
+        bool await_suspend(std::coroutine_handle<> handle) {
+            std::optional<GrantResult> now = bank.submitRequest(
+                processId, request, [this, handle](GrantResult r) { result = r; handle.resume(); });
+            if (!now) return true;
+            result = *now;
+            return false;
+        }
+
+        GrantResult await_resume() const noexcept { return result; }
+    };
+
+    GrantAwaitable requestResourcesAwaitable(int processId, std::vector<int> request) {
+        return GrantAwaitable{*this, processId, std::move(request)};
+    }
+
+    // Where completions of parked requests run; set it before submitting any
+    void setExecutor(Executor newExecutor) {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        executor = std::move(newExecutor);
+    }
+
+    // Where requestResources/releaseResources log; nullptr silences them
+    void setLogger(AsyncLogger* newLogger) {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        logger = newLogger;
+    }
+
+    // Waits until everything this bank logged so far has been written
+    void flushLog() {
+        if (logger != nullptr) logger->flush();
+    }
+
+    // Turning incremental checking off makes every grant run findSafeSequence
+    void setIncrementalSafety(bool enabled) {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        incrementalEnabled = enabled;
+        sequenceValid = false;
+    }
+
+    // Decides a batch of requests under one lock acquisition, without waits
+    // or retries. Requests are considered in policy order (ties keep batch
+    // order) and each is granted if it fits and the state stays safe given
+    // the grants before it: the same outcome as calling tryRequestResources
+    // one by one in that order. Results are returned in batch order.
+    std::vector<GrantResult> grantBatch(const std::vector<PendingRequest>& batch,
+                                        AdmissionPolicy policy = AdmissionPolicy::Fifo) {
+        return grantBatch(batch, admissionOrder(policy));
+    }
+
+    std::vector<GrantResult> grantBatch(const std::vector<PendingRequest>& batch, const AdmissionOrder& before) {
+        std::vector<int> order(batch.size());
+        std::vector<int> requests(batch.size() * stride);
+        for (size_t k = 0; k < batch.size(); ++k) {
+            std::vector<int> req = padded(batch[k].request);
+            std::copy(req.begin(), req.end(), requests.begin() + k * stride);
+            order[k] = static_cast<int>(k);
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [&](int a, int b) { return before(batch[a], batch[b]); });
+
+        BankLock lock(*this);
+        for (const PendingRequest& pending : batch) {
+            checkProcessId(pending.processId);
+        }
+        std::vector<GrantResult> results =
+            admitInOrder(batch, order, [&](int k) { return requests.data() + static_cast<size_t>(k) * stride; });
+        for (size_t k = 0; k < batch.size(); ++k) {
+            countOutcome(results[k]);
+            report(LogLevel::Decisions, outcomeEvent(results[k]), batch[k].processId);
+        }
+        return results;
+    }
+
+    // Available + Allocation still sums to the initial total, rows are
+    // consistent (Need = Maximum - Allocation for active processes, zero for
+    // finished ones) and the state is safe
+    bool checkInvariants() {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        std::vector<int> sum = available;
         for (int i = 0; i < numProcesses; ++i) {
-            if (!finished[i]) {
-                count++;
+            addRow(sum.data(), row(allocation, i), stride);
+            for (int j = 0; j < numResources; ++j) {
+                int expectedNeed = finished[i] ? 0 : row(maximum, i)[j] - row(allocation, i)[j];
+                if (row(allocation, i)[j] < 0 || row(need, i)[j] != expectedNeed) return false;
             }
         }
-        return count;
+        std::vector<int> sequence;
+        return sum == total && findSafeSequence(sequence);
+    }
+
+    // Turning optimistic checking off keeps full checks under bankMutex
+    void setOptimisticSafety(bool enabled) {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        optimisticEnabled = enabled;
+    }
+
+    // With targeted wakeups off, every release wakes every waiter, the way
+    // cv.notify_all() used to
+    void setTargetedWakeups(bool enabled) {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        targetedWakeups = enabled;
+    }
+
+    WaitStats getWaitStats() {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        return waitStats;
+    }
+
+    // Full checks over at least minProcesses candidates run on threads
+    // threads; threads <= 1 keeps every check sequential. The threads - 1
+    // helper threads are started here and reused by every check
+    void setParallelSafety(int threads, size_t minProcesses) {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        int helpers = std::max(1, threads) - 1;
+        if (helpers == 0) {
+            safetyHelpers.reset();
+        } else if (!safetyHelpers || safetyHelpers->size() != helpers) {
+            safetyHelpers = std::make_shared<ThreadPool>(helpers);
+        }
+        parallelMinProcesses = minProcesses;
+    }
+
+    // All zero unless built with BANKER_ENABLE_METRICS, apart from the
+    // counters getSafetyStats and getWaitStats also return
+    MetricsSnapshot getMetrics() {
+        MetricsSnapshot snapshot;
+        snapshot.lockWaitNs = metrics.lockWaitNs.snapshot();
+        snapshot.lockHoldNs = metrics.lockHoldNs.snapshot();
+        snapshot.safetyCheckNs = metrics.safetyCheckNs.snapshot();
+        snapshot.safetyCheckProcesses = metrics.safetyCheckProcesses.snapshot();
+        for (size_t k = 0; k < snapshot.outcomes.size(); ++k) {
+            snapshot.outcomes[k] = metrics.outcomes[k].load(std::memory_order_relaxed);
+        }
+        snapshot.retries = metrics.retries.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(bankMutex);
+        snapshot.safety = safetyStats;
+        snapshot.waits = waitStats;
+        return snapshot;
+    }
+
+    SafetyStats getSafetyStats() {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        return safetyStats;
+    }
+
+    // Rows in the matrices: active, finished and free slots
+    int getProcessSlots() {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        return numProcesses;
+    }
+
+    // Get number of active (not finished) processes
+    int getActiveProcessCount() {
+        std::lock_guard<std::mutex> lock(bankMutex);
+        return static_cast<int>(activeList.size());
     }
 
     // Print current state with better formatting for finished processes
     void printState() {
+        flushLog();
         std::lock_guard<std::mutex> lock(printMutex);
         std::cout << "\n" << std::string(60, '-') << "\n";
         std::cout << "         ТЕКУЩЕЕ СОСТОЯНИЕ СИСТЕМЫ\n";
@@ -354,26 +1757,570 @@ public:
         std::cout << "\n";
 
         // Count active processes
-        int activeCount = getActiveProcessCount();
+        int activeCount = static_cast<int>(activeList.size());
         std::cout << "\nАктивных процессов: " << activeCount << " из " << numProcesses << "\n";
 
-        if (activeCount > 0) {
-            std::cout << "\nМатрица максимальных потребностей (Maximum):\n";
-            printMatrixWithStatus(maximum, "Maximum");
+        if (activeCount > 0) {
+            std::cout << "\nМатрица максимальных потребностей (Maximum):\n";
+            printMatrixWithStatus(maximum, "Maximum");
+
+            std::cout << "\nМатрица выделенных ресурсов (Allocation):\n";
+            printMatrixWithStatus(allocation, "Allocation");
+
+            std::cout << "\nМатрица оставшихся потребностей (Need):\n";
+            printMatrixWithStatus(need, "Need");
+        } else {
+            std::cout << "\n✓ Все процессы завершены, все ресурсы освобождены\n";
+        }
+
+        std::cout << std::string(60, '-') << "\n";
+    }
+
+private:
+    // Caller holds bankMutex: registerProcess can grow the table
+    void checkProcessId(int processId) const {
+        if (processId < 0 || processId >= numProcesses) {
+            throw std::out_of_range("Ошибка: Неверный номер процесса " + std::to_string(processId));
+        }
+    }
+
+    // Queues an event for the logger; no I/O happens on this thread
+    void report(LogLevel eventLevel, LogEvent event, int processId,
+                const int* values = nullptr, int attempt = 0, int maxAttempts = 0) {
+        if (logger == nullptr || !logger->enabled(eventLevel)) return;
+        LogRecord record;
+        record.event = event;
+        record.processId = processId;
+        record.attempt = attempt;
+        record.maxAttempts = maxAttempts;
+        if (values != nullptr) record.setValues(values, numResources);
+        logger->log(eventLevel, record);
+    }
+
+    // Caller holds bankMutex. Returns the whole allocation and marks the
+    // process finished. Earlier steps of the remembered sequence gain the
+    // allocation; the process's own step stops constraining grants
+    void finishProcess(int processId) {
+        if (sequenceValid && sequencePosition[processId] >= 0) {
+            int step = sequencePosition[processId];
+            slackTree.addPrefix(step, row(allocation, processId), 1);
+            slackTree.release(step);
+            sequencePosition[processId] = -1;
+        }
+        releaseVersion++;
+
+        // Release all allocated resources
+        addRow(available.data(), row(allocation, processId), stride);
+        std::fill(row(allocation, processId), row(allocation, processId) + stride, 0);
+        std::fill(row(need, processId), row(need, processId) + stride, 0); // Process finished - no more needs
+
+        finished[processId] = true;
+        activeList.erase(std::lower_bound(activeList.begin(), activeList.end(), processId));
+    }
+
+    // bankMutex taken by a request or release path. With metrics compiled in
+    // it records how long taking the lock waited and how long it was held
+    class BankLock {
+    public:
+        explicit BankLock(BankersAlgorithm& owner) : bank(owner), inner(owner.bankMutex, std::defer_lock) {
+            lock();
+        }
+
+        ~BankLock() {
+            if (inner.owns_lock()) endHold();
+        }
+
+        void lock() {
+            if constexpr (METRICS_ENABLED) {
+                MetricsClock::time_point start = MetricsClock::now();
+                inner.lock();
+                heldSince = MetricsClock::now();
+                bank.metrics.lockWaitNs.record(nanosecondsBetween(start, heldSince));
+            } else {
+                inner.lock();
+            }
+        }
+
+        void unlock() {
+            endHold();
+            inner.unlock();
+        }
+
+        // Runs wait(lock) for a condition variable; the wait is not counted
+        // as holding the lock
+        template<typename Wait>
+        bool waitOn(Wait wait) {
+            endHold();
+            bool result = wait(inner);
+            if constexpr (METRICS_ENABLED) heldSince = MetricsClock::now();
+            return result;
+        }
+
+    private:
+        BankersAlgorithm& bank;
+        std::unique_lock<std::mutex> inner;
+        MetricsClock::time_point heldSince;
+
+        void endHold() {
+            if constexpr (METRICS_ENABLED) {
+                bank.metrics.lockHoldNs.record(nanosecondsBetween(heldSince, MetricsClock::now()));
+            }
+        }
+    };
+
+    void countOutcome(GrantResult result) {
+        if constexpr (METRICS_ENABLED) {
+            metrics.outcomes[static_cast<int>(result)].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    static LogEvent outcomeEvent(GrantResult result) {
+        static const LogEvent events[] = {LogEvent::Granted, LogEvent::RejectedFinished, LogEvent::RejectedNeed,
+                                          LogEvent::RejectedUnavailable, LogEvent::RejectedUnsafe};
+        return events[static_cast<int>(result)];
+    }
+
+    // lock holds bankMutex after a release. Decides the parked requests in
+    // arrival order, then unlocks and hands the completions to the executor
+    void resumeParked(BankLock& lock) {
+        if (parked.empty()) return;
+        std::vector<std::function<void()>> ready;
+        admitParked(ready);
+        if (ready.empty()) return;
+        waitStats.resumed += static_cast<long long>(ready.size());
+
+        Executor run = executor;
+        lock.unlock();
+        for (auto& task : ready) {
+            if (run) run(std::move(task));
+            else task();
+        }
+    }
+
+    // Caller holds bankMutex. Requests of finished processes are dropped.
+    // A request that fits available is granted if the remembered sequence
+    // confirms it or grantReaches proves it safe, so a grant that would be
+    // safe never stays parked. Requests that do not fit, or are unsafe,
+    // wait for the next release
+    void admitParked(std::vector<std::function<void()>>& ready) {
+        std::vector<GrantReach> reaches;
+        size_t kept = 0;
+        for (size_t k = 0; k < parked.size(); ++k) {
+            ParkedRequest& request = parked[k];
+            const int pid = request.processId;
+            const int* req = request.request.data();
+            GrantResult result = GrantResult::Unavailable;
+            if (finished[pid] || slotGeneration[pid] != request.generation) {
+                result = GrantResult::ProcessFinished;
+            } else if (!rowLessEqual(req, row(need, pid), stride)) {
+                result = GrantResult::ExceedsNeed;
+            } else if (rowLessEqual(req, available.data(), stride)) {
+                int step = sequenceValid ? sequencePosition[pid] : -1;
+                if (step >= 0 && slackTree.coversPrefix(step, req)) {
+                    applyGrant(pid, req);
+                    slackTree.addPrefix(step, req, -1);
+                    safetyStats.incrementalChecks++;
+                    result = GrantResult::Granted;
+                } else if (grantReaches(pid, req, reaches) &&
+                           grantWithFullCheck(pid, req) == GrantResult::Granted) {
+                    // The full check also refreshes the remembered sequence
+                    result = GrantResult::Granted;
+                }
+                if (result == GrantResult::Granted) reaches.clear();
+            }
+            if (result == GrantResult::Unavailable) {
+                if (kept != k) parked[kept] = std::move(request);
+                kept++;
+                continue;
+            }
+            countOutcome(result);
+            report(LogLevel::Decisions, outcomeEvent(result), pid);
+            ready.push_back([complete = std::move(request.complete), result]() { complete(result); });
+        }
+        parked.erase(parked.begin() + kept, parked.end());
+    }
+
+    // Processes that can finish on the current state once request is taken
+    // out of available, and the work they leave behind
+    struct GrantReach {
+        std::vector<int> request;   // padded
+        std::vector<bool> finishes;
+        std::vector<int> work;
+    };
+
+    // Caller holds bankMutex; the current state is safe. Granting req to
+    // processId is safe iff the process can still finish: once it has, the
+    // work equals what the same steps leave in the current state, from
+    // which the rest are known to finish. Processes other than processId
+    // keep their rows, so one reduction from available - req decides every
+    // parked request with that vector: safe iff the process is among those
+    // that finish, or their work plus req covers its need. reaches caches
+    // the reductions and must be cleared when the state changes.
+    bool grantReaches(int processId, const int* req, std::vector<GrantReach>& reaches) {
+        auto it = std::find_if(reaches.begin(), reaches.end(), [&](const GrantReach& reach) {
+            return std::equal(reach.request.begin(), reach.request.end(), req);
+        });
+        if (it == reaches.end()) {
+            GrantReach reach;
+            reach.request.assign(req, req + stride);
+            reach.work = available;
+            subRow(reach.work.data(), req, stride);
+            SafetyView state = view();
+            state.available = reach.work.data();
+            std::vector<int> sequence;
+            safetyStats.fullChecks++;
+            runSafetyCheck(state, activeProcesses(), sequence, nullptr);
+            reach.finishes.assign(numProcesses, false);
+            for (int i : sequence) {
+                reach.finishes[i] = true;
+                addRow(reach.work.data(), row(allocation, i), stride);
+            }
+            reaches.push_back(std::move(reach));
+            it = reaches.end() - 1;
+        }
+        if (it->finishes[processId]) return true;
+        std::vector<int> covered = it->work;
+        addRow(covered.data(), req, stride);
+        return rowLessEqual(row(need, processId), covered.data(), stride);
+    }
+
+    struct RequesterScope {
+        std::atomic<int>& counter;
+        explicit RequesterScope(std::atomic<int>& c) : counter(c) { counter.fetch_add(1, std::memory_order_relaxed); }
+        ~RequesterScope() { counter.fetch_sub(1, std::memory_order_relaxed); }
+    };
+
+    void moveToAllocation(int processId, const int* req) {
+        subRow(available.data(), req, stride);
+        addRow(row(allocation, processId), req, stride);
+        subRow(row(need, processId), req, stride);
+    }
+
+    void moveToAvailable(int processId, const int* req) {
+        addRow(available.data(), req, stride);
+        subRow(row(allocation, processId), req, stride);
+        addRow(row(need, processId), req, stride);
+    }
+
+    void applyGrant(int processId, const int* req) {
+        moveToAllocation(processId, req);
+        grantVersion++;
+    }
+
+    void revertGrant(int processId, const int* req) {
+        moveToAvailable(processId, req);
+        grantVersion++;
+    }
+
+    // Caller holds bankMutex. Requests the remembered sequence confirms are
+    // granted one by one. A request it cannot confirm gets a full check of
+    // its own, as a single call would; a safe verdict becomes the remembered
+    // sequence and an unsafe one leaves it valid, so the rest of the batch
+    // goes back to the incremental path. Without incremental checking every
+    // request that fits is applied and a single full check covers them all;
+    // if it fails, the first unsafe grant is found by binary search over the
+    // applied prefix (granting more never turns an unsafe state safe), the
+    // safe prefix is kept, that request is rejected and the rest go around
+    // again. Such a batch with f unsafe requests costs O(f·log b) full checks.
+    template<typename RequestOf>
+    std::vector<GrantResult> admitInOrder(const std::vector<PendingRequest>& batch,
+                                          const std::vector<int>& order, RequestOf requestOf) {
+        std::vector<GrantResult> results(batch.size(), GrantResult::Unsafe);
+        auto precheck = [&](int k) {
+            int pid = batch[k].processId;
+            const int* req = requestOf(k);
+            if (finished[pid]) return GrantResult::ProcessFinished;
+            if (!rowLessEqual(req, row(need, pid), stride)) return GrantResult::ExceedsNeed;
+            if (!rowLessEqual(req, available.data(), stride)) return GrantResult::Unavailable;
+            return GrantResult::Granted;
+        };
+
+        size_t next = 0;
+        while (incrementalEnabled && next < order.size()) {
+            for (; next < order.size() && sequenceValid; ++next) {
+                int k = order[next];
+                results[k] = precheck(k);
+                if (results[k] != GrantResult::Granted) continue;
+                int pid = batch[k].processId;
+                int step = sequencePosition[pid];
+                if (step < 0 || !slackTree.coversPrefix(step, requestOf(k))) break;
+                applyGrant(pid, requestOf(k));
+                slackTree.addPrefix(step, requestOf(k), -1);
+                safetyStats.incrementalChecks++;
+            }
+            if (next == order.size()) break;
+
+            int k = order[next++];
+            results[k] = precheck(k);
+            if (results[k] == GrantResult::Granted) {
+                results[k] = grantWithFullCheck(batch[k].processId, requestOf(k));
+            }
+        }
+
+        std::vector<int> sequence;
+        while (next < order.size()) {
+            std::vector<size_t> applied;   // positions in order
+            for (size_t pos = next; pos < order.size(); ++pos) {
+                int k = order[pos];
+                results[k] = precheck(k);
+                if (results[k] == GrantResult::Granted) {
+                    applyGrant(batch[k].processId, requestOf(k));
+                    applied.push_back(pos);
+                }
+            }
+            if (applied.empty()) break;
+
+            safetyStats.fullChecks++;
+            if (runSafetyCheck(view(), activeProcesses(), sequence)) break;
+
+            // Longest safe prefix: prefix lo is safe, prefix hi is not
+            size_t lo = 0, hi = applied.size(), current = applied.size();
+            auto moveTo = [&](size_t target) {
+                for (; current > target; --current) {
+                    int k = order[applied[current - 1]];
+                    revertGrant(batch[k].processId, requestOf(k));
+                }
+                for (; current < target; ++current) {
+                    int k = order[applied[current]];
+                    applyGrant(batch[k].processId, requestOf(k));
+                }
+            };
+            while (hi - lo > 1) {
+                size_t mid = (lo + hi) / 2;
+                moveTo(mid);
+                safetyStats.fullChecks++;
+                if (runSafetyCheck(view(), activeProcesses(), sequence)) lo = mid;
+                else hi = mid;
+            }
+            moveTo(lo);
+            results[order[applied[lo]]] = GrantResult::Unsafe;
+            next = applied[lo] + 1;
+        }
+        return results;
+    }
+
+    // Caller holds bankMutex. Parks the caller until a release makes its
+    // request likely to succeed or the timeout passes; true if woken
+    bool waitForRelease(BankLock& lock, int processId, const int* req, int timeoutMs) {
+        Waiter waiter{processId, req, {}, false};
+        waitQueue.push_back(&waiter);
+        waitStats.waits++;
+        bool woken = lock.waitOn([&](std::unique_lock<std::mutex>& held) {
+            return waiter.cv.wait_for(held, std::chrono::milliseconds(timeoutMs), [&]() { return waiter.woken; });
+        });
+        if (!woken) {
+            waitQueue.erase(std::find(waitQueue.begin(), waitQueue.end(), &waiter));
+            waitStats.timeouts++;
+        }
+        return woken;
+    }
+
+    // Caller holds bankMutex. Wakes, in arrival order, the waiters whose
+    // request fits in what earlier woken waiters left of available and
+    // would pass the safety check on the current state; waiters of finished
+    // processes are woken so they can return. Everyone else keeps sleeping.
+    void wakeWaiters() {
+        std::vector<int> budget = available;
+        size_t kept = 0;
+        for (Waiter* waiter : waitQueue) {
+            bool wake = !targetedWakeups || finished[waiter->processId];
+            if (!wake && rowLessEqual(waiter->request, budget.data(), stride) &&
+                grantWouldBeSafe(waiter->processId, waiter->request)) {
+                subRow(budget.data(), waiter->request, stride);
+                wake = true;
+            }
+            if (wake) {
+                waiter->woken = true;
+                waiter->cv.notify_one();
+                waitStats.wakeups++;
+            } else {
+                waitQueue[kept++] = waiter;
+            }
+        }
+        waitQueue.resize(kept);
+    }
+
+    // Caller holds bankMutex; the state is left as it was
+    bool grantWouldBeSafe(int processId, const int* req) {
+        if (!rowLessEqual(req, row(need, processId), stride)) return false;
+        if (incrementalEnabled && sequenceValid) {
+            int step = sequencePosition[processId];
+            if (step >= 0 && slackTree.coversPrefix(step, req)) return true;
+        }
+        std::vector<int> sequence;
+        moveToAllocation(processId, req);
+        bool safe = runSafetyCheck(view(), activeProcesses(), sequence);
+        moveToAvailable(processId, req);
+        return safe;
+    }
+
+    // One allocation attempt; lock holds bankMutex on entry and on return.
+    // Grants the remembered sequence can confirm are decided on the spot.
+    // Otherwise, if other requesters are waiting to get in, the full check
+    // runs on a snapshot with the lock released,
+    // and its verdict is applied only if no grant happened meanwhile; after
+    // OPTIMISTIC_ATTEMPTS conflicts the check runs under the lock.
+    GrantResult tryGrant(int processId, const int* req, BankLock& lock) {
+        GrantResult result = decideGrant(processId, req, lock);
+        countOutcome(result);
+        return result;
+    }
+
+    GrantResult decideGrant(int processId, const int* req, BankLock& lock) {
+        const uint64_t generation = slotGeneration[processId];
+        for (int attempt = 0; ; ++attempt) {
+            if (finished[processId]) return GrantResult::ProcessFinished;
+            if (!rowLessEqual(req, row(need, processId), stride)) return GrantResult::ExceedsNeed;
+            if (!rowLessEqual(req, available.data(), stride)) return GrantResult::Unavailable;
+
+            if (incrementalEnabled && sequenceValid) {
+                int step = sequencePosition[processId];
+                if (step >= 0 && slackTree.coversPrefix(step, req)) {
+                    applyGrant(processId, req);
+                    slackTree.addPrefix(step, req, -1);
+                    safetyStats.incrementalChecks++;
+                    return GrantResult::Granted;
+                }
+            }
+
+            if (!optimisticEnabled || attempt >= OPTIMISTIC_ATTEMPTS ||
+                requestersInside.load(std::memory_order_relaxed) < 2) {
+                return grantWithFullCheck(processId, req);
+            }
+
+            OptimisticCheck check;
+            takeSnapshot(processId, req, check);
+            lock.unlock();
+            runSnapshotCheck(check);
+            lock.lock();
+            if (slotGeneration[processId] != generation) return GrantResult::ProcessFinished;
+
+            safetyStats.optimisticChecks++;
+            if (check.grantVersion != grantVersion ||
+                (!check.safe && check.releaseVersion != releaseVersion)) {
+                // A grant may have made the verdict stale, or a release may
+                // have made an unsafe state safe
+                safetyStats.optimisticConflicts++;
+                continue;
+            }
+            safetyStats.fullChecks++;
+            if (!check.safe) return GrantResult::Unsafe;
+
+            // The safe verdict survives releases, but the release may have
+            // been this process finishing, so the prechecks run again
+            if (check.releaseVersion != releaseVersion) {
+                if (finished[processId]) return GrantResult::ProcessFinished;
+                if (!rowLessEqual(req, row(need, processId), stride)) return GrantResult::ExceedsNeed;
+                if (!rowLessEqual(req, available.data(), stride)) return GrantResult::Unavailable;
+            }
+
+            applyGrant(processId, req);
+            if (incrementalEnabled && check.releaseVersion == releaseVersion) {
+                sequencePosition.assign(numProcesses, -1);
+                for (size_t k = 0; k < check.sequence.size(); ++k) {
+                    sequencePosition[check.ids[check.sequence[k]]] = static_cast<int>(k);
+                }
+                std::swap(slackTree, check.tree);
+                sequenceValid = true;
+            } else {
+                sequenceValid = false;
+            }
+            return GrantResult::Granted;
+        }
+    }
+
+    // Caller holds bankMutex
+    GrantResult grantWithFullCheck(int processId, const int* req) {
+        // Temporarily allocate resources
+        applyGrant(processId, req);
+
+        // Check if state is safe
+        safetyStats.fullChecks++;
+        std::vector<int> sequence;
+        if (runSafetyCheck(view(), activeProcesses(), sequence)) {
+            if (incrementalEnabled) {
+                rememberSequence(sequence);
+            }
+            return GrantResult::Granted;
+        }
+
+        // Rollback allocation
+        revertGrant(processId, req);
+        return GrantResult::Unsafe;
+    }
+
+    // Caller holds bankMutex. Copies the unfinished rows with req granted
+    void takeSnapshot(int processId, const int* req, OptimisticCheck& check) {
+        check.grantVersion = grantVersion;
+        check.releaseVersion = releaseVersion;
+        check.buildTree = incrementalEnabled;
+        check.ids = activeProcesses();
+        check.helpers = helpersFor(check.ids.size());
+        check.available = available;
+        subRow(check.available.data(), req, stride);
+        check.need.resize(check.ids.size() * stride);
+        check.allocation.resize(check.ids.size() * stride);
+        for (size_t r = 0; r < check.ids.size(); ++r) {
+            int i = check.ids[r];
+            std::copy(row(need, i), row(need, i) + stride, check.need.begin() + r * stride);
+            std::copy(row(allocation, i), row(allocation, i) + stride, check.allocation.begin() + r * stride);
+            if (i == processId) {
+                subRow(check.need.data() + r * stride, req, stride);
+                addRow(check.allocation.data() + r * stride, req, stride);
+            }
+        }
+    }
+
+    // Caller holds bankMutex
+    std::shared_ptr<ThreadPool> helpersFor(size_t candidates) const {
+        return candidates >= parallelMinProcesses ? safetyHelpers : nullptr;
+    }
+
+    bool runSafetyCheck(const SafetyView& state, std::vector<int> candidates,
+                        std::vector<int>& sequence, ThreadPool* helpers) const {
+        MetricsClock::time_point start;
+        if constexpr (METRICS_ENABLED) {
+            metrics.safetyCheckProcesses.record(candidates.size());
+            start = MetricsClock::now();
+        }
+        bool safe = helpers != nullptr
+            ? computeSafeSequenceParallel(state, std::move(candidates), sequence, *helpers)
+            : computeSafeSequence(state, std::move(candidates), sequence);
+        if constexpr (METRICS_ENABLED) {
+            metrics.safetyCheckNs.record(nanosecondsBetween(start, MetricsClock::now()));
+        }
+        return safe;
+    }
 
-            std::cout << "\nМатрица выделенных ресурсов (Allocation):\n";
-            printMatrixWithStatus(allocation, "Allocation");
+    // Caller holds bankMutex
+    bool runSafetyCheck(const SafetyView& state, std::vector<int> candidates,
+                        std::vector<int>& sequence) const {
+        std::shared_ptr<ThreadPool> helpers = helpersFor(candidates.size());
+        return runSafetyCheck(state, std::move(candidates), sequence, helpers.get());
+    }
 
-            std::cout << "\nМатрица оставшихся потребностей (Need):\n";
-            printMatrixWithStatus(need, "Need");
-        } else {
-            std::cout << "\n✓ Все процессы завершены, все ресурсы освобождены\n";
+    // Runs without bankMutex; reads only the snapshot and immutable sizes,
+    // and records into the atomic metrics
+    void runSnapshotCheck(OptimisticCheck& check) const {
+        SafetyView snapshot{static_cast<int>(check.ids.size()), numResources, stride,
+                            check.available.data(), check.need.data(), check.allocation.data()};
+        std::vector<int> rows(check.ids.size());
+        for (size_t r = 0; r < rows.size(); ++r) rows[r] = static_cast<int>(r);
+        check.safe = runSafetyCheck(snapshot, std::move(rows), check.sequence, check.helpers.get());
+        if (check.safe && check.buildTree) {
+            buildSlackTree(snapshot, check.sequence, check.tree);
         }
+    }
 
-        std::cout << std::string(60, '-') << "\n";
+    void rememberSequence(const std::vector<int>& sequence) {
+        sequencePosition.assign(numProcesses, -1);
+        for (size_t k = 0; k < sequence.size(); ++k) {
+            sequencePosition[sequence[k]] = static_cast<int>(k);
+        }
+        buildSlackTree(view(), sequence, slackTree);
+        sequenceValid = true;
     }
 
-private:
     void printVector(const std::vector<int>& v) {
         std::cout << "[";
         for (size_t i = 0; i < v.size(); ++i) {
@@ -383,7 +2330,7 @@ private:
         std::cout << "]\n";
     }
 
-    void printMatrixWithStatus(const std::vector<std::vector<int>>& matrix, 
+    void printMatrixWithStatus(const std::vector<int>& matrix, 
                                const std::string& matrixName) {
         std::cout << "     ";
         for (int j = 0; j < numResources; ++j) {
@@ -396,14 +2343,14 @@ private:
             if (!finished[i]) {
                 std::cout << "   P" << i << ": ";
                 for (int j = 0; j < numResources; ++j) {
-                    std::cout << std::setw(4) << matrix[i][j];
+                    std::cout << std::setw(4) << row(matrix, i)[j];
                 }
                 std::cout << "    [Active]\n";
             }
         }
     }
 
-    void printMatrix(const std::vector<std::vector<int>>& matrix, const std::string& rowPrefix) {
+    void printMatrix(const std::vector<int>& matrix, const std::string& rowPrefix) {
         std::cout << "     ";
         for (int j = 0; j < numResources; ++j) {
             std::cout << std::setw(4) << "R" << j;
@@ -413,13 +2360,223 @@ private:
         for (int i = 0; i < numProcesses; ++i) {
             std::cout << "   " << rowPrefix << i << ": ";
             for (int j = 0; j < numResources; ++j) {
-                std::cout << std::setw(4) << matrix[i][j];
+                std::cout << std::setw(4) << row(matrix, i)[j];
             }
             std::cout << "\n";
         }
     }
 };
 
+// ==================== Sharded Banker ====================
+
+// Splits a bank into independent shards. Two resource types belong to the
+// same shard when some process may hold both (maximum or allocation > 0);
+// a process belongs to the shard of the resources it uses. Processes never
+// need anything outside their shard, so the state is safe exactly when
+// every shard is safe, and each shard keeps its own bankMutex and safety
+// state. Ids stay global; shards see local ones. Processes with no claims
+// at all go to the shard of resource 0. Shard logging is off because it
+// would print local ids.
+class ShardedBanker {
+private:
+    int numProcesses;
+    int numResources;
+    std::vector<std::unique_ptr<BankersAlgorithm>> shards;
+    std::vector<std::vector<int>> shardResources;   // global resource ids of each shard
+    std::vector<int> processShard;
+    std::vector<int> localProcess;
+    std::vector<int> resourceShard;
+    std::vector<int> localResource;
+
+    static int findRoot(std::vector<int>& parent, int x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    void checkProcessId(int processId) const {
+        if (processId < 0 || processId >= numProcesses) {
+            throw std::out_of_range("Ошибка: Неверный номер процесса " + std::to_string(processId));
+        }
+    }
+
+    // Global request -> shard-local one. False if it asks for a resource
+    // outside the process's shard, which always exceeds its need
+    bool toLocal(int processId, const std::vector<int>& request, std::vector<int>& local) const {
+        if (static_cast<int>(request.size()) != numResources) {
+            throw std::invalid_argument("Ошибка: Длина запроса не совпадает с числом ресурсов");
+        }
+        int shard = processShard[processId];
+        local.assign(shardResources[shard].size(), 0);
+        for (int j = 0; j < numResources; ++j) {
+            if (resourceShard[j] == shard) {
+                local[localResource[j]] = request[j];
+            } else if (request[j] != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+public:
+    ShardedBanker(int processes, int resources,
+                  const std::vector<int>& avail,
+                  const std::vector<std::vector<int>>& max,
+                  const std::vector<std::vector<int>>& alloc)
+        : numProcesses(processes),
+          numResources(resources),
+          processShard(processes),
+          localProcess(processes),
+          resourceShard(resources, -1),
+          localResource(resources)
+    {
+        if (static_cast<int>(avail.size()) != numResources) {
+            throw std::invalid_argument("Ошибка: Длина запроса не совпадает с числом ресурсов");
+        }
+        if (static_cast<int>(max.size()) != numProcesses ||
+            static_cast<int>(alloc.size()) != numProcesses) {
+            throw std::invalid_argument("Ошибка: Число строк матриц не совпадает с числом процессов");
+        }
+        for (int i = 0; i < numProcesses; ++i) {
+            if (static_cast<int>(max[i].size()) != numResources ||
+                static_cast<int>(alloc[i].size()) != numResources) {
+                throw std::invalid_argument("Ошибка: Неверная длина строки процесса P" + std::to_string(i));
+            }
+        }
+        if (numResources == 0) {
+            throw std::invalid_argument("Ошибка: Нет ни одного типа ресурсов");
+        }
+
+        // Union the resources each process uses
+        std::vector<int> parent(numResources);
+        for (int j = 0; j < numResources; ++j) parent[j] = j;
+        std::vector<int> firstUsed(numProcesses, 0);
+        for (int i = 0; i < numProcesses; ++i) {
+            int first = -1;
+            for (int j = 0; j < numResources; ++j) {
+                if (max[i][j] == 0 && alloc[i][j] == 0) continue;
+                if (first < 0) {
+                    first = j;
+                } else {
+                    parent[findRoot(parent, j)] = findRoot(parent, first);
+                }
+            }
+            firstUsed[i] = std::max(first, 0);
+        }
+
+        // Number the shards in order of their lowest resource
+        std::vector<int> rootShard(numResources, -1);
+        for (int j = 0; j < numResources; ++j) {
+            int root = findRoot(parent, j);
+            if (rootShard[root] < 0) {
+                rootShard[root] = static_cast<int>(shardResources.size());
+                shardResources.emplace_back();
+            }
+            resourceShard[j] = rootShard[root];
+            localResource[j] = static_cast<int>(shardResources[resourceShard[j]].size());
+            shardResources[resourceShard[j]].push_back(j);
+        }
+
+        std::vector<std::vector<int>> shardProcesses(shardResources.size());
+        for (int i = 0; i < numProcesses; ++i) {
+            processShard[i] = resourceShard[firstUsed[i]];
+            localProcess[i] = static_cast<int>(shardProcesses[processShard[i]].size());
+            shardProcesses[processShard[i]].push_back(i);
+        }
+
+        for (size_t s = 0; s < shardResources.size(); ++s) {
+            const std::vector<int>& columns = shardResources[s];
+            std::vector<int> shardAvail;
+            for (int j : columns) shardAvail.push_back(avail[j]);
+            std::vector<std::vector<int>> shardMax, shardAlloc;
+            for (int i : shardProcesses[s]) {
+                shardMax.emplace_back();
+                shardAlloc.emplace_back();
+                for (int j : columns) {
+                    shardMax.back().push_back(max[i][j]);
+                    shardAlloc.back().push_back(alloc[i][j]);
+                }
+            }
+            shards.push_back(std::make_unique<BankersAlgorithm>(
+                static_cast<int>(shardProcesses[s].size()), static_cast<int>(columns.size()),
+                shardAvail, shardMax, shardAlloc));
+            shards.back()->setLogger(nullptr);
+        }
+    }
+
+    int getShardCount() const {
+        return static_cast<int>(shards.size());
+    }
+
+    int shardOf(int processId) const {
+        checkProcessId(processId);
+        return processShard[processId];
+    }
+
+    // Shard-local bank, for its statistics and settings
+    BankersAlgorithm& shard(int index) {
+        return *shards.at(index);
+    }
+
+    GrantResult tryRequestResources(int processId, const std::vector<int>& request) {
+        checkProcessId(processId);
+        std::vector<int> local;
+        if (!toLocal(processId, request, local)) return GrantResult::ExceedsNeed;
+        return shards[processShard[processId]]->tryRequestResources(localProcess[processId], local);
+    }
+
+    bool requestResources(int processId, const std::vector<int>& request,
+                          int maxRetries = 5, int timeoutMs = 1000) {
+        checkProcessId(processId);
+        std::vector<int> local;
+        if (!toLocal(processId, request, local)) return false;
+        return shards[processShard[processId]]->requestResources(localProcess[processId], local,
+                                                                maxRetries, timeoutMs);
+    }
+
+    void releaseResources(int processId) {
+        checkProcessId(processId);
+        shards[processShard[processId]]->releaseResources(localProcess[processId]);
+    }
+
+    bool releaseResources(int processId, const std::vector<int>& amounts) {
+        checkProcessId(processId);
+        std::vector<int> local;
+        if (!toLocal(processId, amounts, local)) return false;
+        return shards[processShard[processId]]->releaseResources(localProcess[processId], local);
+    }
+
+    std::vector<int> allocationOf(int processId) {
+        checkProcessId(processId);
+        int shard = processShard[processId];
+        std::vector<int> local = shards[shard]->allocationOf(localProcess[processId]);
+        std::vector<int> result(numResources, 0);
+        for (size_t k = 0; k < local.size(); ++k) {
+            result[shardResources[shard][k]] = local[k];
+        }
+        return result;
+    }
+
+    // Safe exactly when every shard is
+    bool isSafe() const {
+        return std::all_of(shards.begin(), shards.end(),
+                           [](const std::unique_ptr<BankersAlgorithm>& s) { return s->isSafe(); });
+    }
+
+    bool checkInvariants() {
+        return std::all_of(shards.begin(), shards.end(),
+                           [](const std::unique_ptr<BankersAlgorithm>& s) { return s->checkInvariants(); });
+    }
+
+    int getActiveProcessCount() const {
+        int count = 0;
+        for (const auto& s : shards) count += s->getActiveProcessCount();
+        return count;
+    }
+};
+
 // ==================== Process Simulation ====================
 void simulateProcess(BankersAlgorithm& bank, int processId,
                     const std::vector<std::vector<int>>& requests) {
@@ -443,8 +2600,957 @@ void simulateProcess(BankersAlgorithm& bank, int processId,
     bank.releaseResources(processId);
 }
 
+// ==================== Random Configurations ====================
+
+struct BankConfig {
+    int processes = 0;
+    int resources = 0;
+    std::vector<int> available;
+    std::vector<std::vector<int>> maximum;
+    std::vector<std::vector<int>> allocation;
+};
+
+enum class ConfigShape {
+    Random,   // independent needs: most processes fit after a few releases
+    Chained   // each process needs nearly everything released before it
+};
+
+// Random state that is safe by construction: processes get random
+// allocations, and needs are drawn against the work available when a random
+// permutation runs them in order. With unsafeShare > 0 that fraction of
+// states gets one need that exceeds the total, making it unsafe.
+BankConfig makeRandomConfig(int processes, int resources, unsigned seed,
+                            ConfigShape shape = ConfigShape::Random,
+                            double unsafeShare = 0.0, int maxUnits = 10) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<> units(0, maxUnits);
+    BankConfig config;
+    config.processes = processes;
+    config.resources = resources;
+    config.maximum.assign(processes, std::vector<int>(resources));
+    config.allocation.assign(processes, std::vector<int>(resources));
+    config.available.assign(resources, 0);
+    for (int i = 0; i < processes; ++i) {
+        for (int j = 0; j < resources; ++j) {
+            config.allocation[i][j] = units(gen);
+        }
+    }
+    for (int j = 0; j < resources; ++j) {
+        config.available[j] = units(gen);
+    }
+
+    std::vector<int> order(processes);
+    for (int i = 0; i < processes; ++i) order[i] = i;
+    std::shuffle(order.begin(), order.end(), gen);
+
+    std::vector<int> work = config.available;
+    for (int p : order) {
+        for (int j = 0; j < resources; ++j) {
+            int needed = shape == ConfigShape::Chained ? std::max(0, work[j] - units(gen))
+                                                       : std::min(work[j], units(gen));
+            config.maximum[p][j] = config.allocation[p][j] + needed;
+        }
+        for (int j = 0; j < resources; ++j) {
+            work[j] += config.allocation[p][j];
+        }
+    }
+
+    if (std::uniform_real_distribution<>(0.0, 1.0)(gen) < unsafeShare) {
+        int p = std::uniform_int_distribution<>(0, processes - 1)(gen);
+        int j = std::uniform_int_distribution<>(0, resources - 1)(gen);
+        config.maximum[p][j] = work[j] + 1;
+    }
+    return config;
+}
+
+// Block-diagonal state: groups of processes that share no resource types,
+// each group drawn like makeRandomConfig
+BankConfig makeShardedConfig(int groups, int processesPerGroup, int resourcesPerGroup, unsigned seed) {
+    BankConfig config;
+    config.processes = groups * processesPerGroup;
+    config.resources = groups * resourcesPerGroup;
+    config.maximum.assign(config.processes, std::vector<int>(config.resources, 0));
+    config.allocation.assign(config.processes, std::vector<int>(config.resources, 0));
+    for (int g = 0; g < groups; ++g) {
+        BankConfig part = makeRandomConfig(processesPerGroup, resourcesPerGroup, seed + g);
+        config.available.insert(config.available.end(), part.available.begin(), part.available.end());
+        for (int i = 0; i < processesPerGroup; ++i) {
+            std::copy(part.maximum[i].begin(), part.maximum[i].end(),
+                      config.maximum[g * processesPerGroup + i].begin() + g * resourcesPerGroup);
+            std::copy(part.allocation[i].begin(), part.allocation[i].end(),
+                      config.allocation[g * processesPerGroup + i].begin() + g * resourcesPerGroup);
+        }
+    }
+    return config;
+}
+
+BankersAlgorithm makeBank(const BankConfig& config) {
+    return BankersAlgorithm(config.processes, config.resources, config.available,
+                            config.maximum, config.allocation);
+}
+
+// ==================== Benchmarks ====================
+
+template<typename Func>
+double measureTime(Func func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+// Sorted-queue safety check vs the round-based scan. Verdicts are compared
+// on every state; sequences may differ but each must replay as safe.
+int runSafetyBenchmark(int maxProcesses, int resources, int trials) {
+    int mismatches = 0;
+    for (ConfigShape shape : {ConfigShape::Random, ConfigShape::Chained}) {
+        std::cout << "\nСравнение алгоритмов безопасности, "
+                  << (shape == ConfigShape::Random ? "независимые потребности" : "цепочка потребностей")
+                  << " (ресурсов: " << resources << ", состояний на размер: " << trials << ")\n";
+        std::cout << " процессов    перебор, мкс      новый, мкс   ускорение  безопасных\n";
+
+        for (int n = 125; n <= maxProcesses; n *= 2) {
+            double scanTime = 0, sortedTime = 0;
+            int safeCount = 0;
+            for (int t = 0; t < trials; ++t) {
+                BankersAlgorithm bank = makeBank(makeRandomConfig(n, resources, 1000u * n + t, shape, 0.3));
+                std::vector<int> scanSequence, sortedSequence;
+                bool scanSafe = false, sortedSafe = false;
+                scanTime += measureTime([&]() { scanSafe = bank.findSafeSequenceScan(scanSequence); });
+                sortedTime += measureTime([&]() { sortedSafe = bank.findSafeSequence(sortedSequence); });
+                if (scanSafe != sortedSafe || (sortedSafe && !bank.replaysSafely(sortedSequence))) {
+                    mismatches++;
+                }
+                safeCount += sortedSafe;
+            }
+            std::cout << std::setw(10) << n << std::fixed << std::setprecision(1)
+                      << std::setw(16) << scanTime / trials << std::setw(16) << sortedTime / trials
+                      << std::setw(11) << scanTime / std::max(sortedTime, 1e-9) << "x"
+                      << std::setw(8) << safeCount << "/" << trials << "\n";
+        }
+    }
+
+    std::cout << (mismatches == 0 ? "\n✓ Вердикты совпадают на всех состояниях\n"
+                                  : "\n✗ Расхождений: " + std::to_string(mismatches) + "\n");
+    return mismatches == 0 ? 0 : 1;
+}
+
+// Sequential vs parallel full safety check on growing states. Both must
+// agree on every state; the first size where the parallel check is faster
+// is reported as the crossover.
+int runParallelSafetyBenchmark(int maxProcesses, int resources, int threads) {
+    const int trials = 3;
+    std::cout << "\nПараллельная проверка безопасности (ресурсов: " << resources
+              << ", потоков: " << threads << ", состояний на размер: " << trials << ")\n";
+    std::cout << " процессов  последовательно, мкс  параллельно, мкс   ускорение  безопасных\n";
+
+    int mismatches = 0, crossover = 0;
+    for (int n = 1000; n <= maxProcesses; n *= 2) {
+        double sequentialTime = 0, parallelTime = 0;
+        int safeCount = 0;
+        for (int t = 0; t < trials; ++t) {
+            BankersAlgorithm bank = makeBank(makeRandomConfig(n, resources, 1000u * n + t,
+                                                              ConfigShape::Random, 0.3));
+            std::vector<int> sequentialSequence, parallelSequence;
+            bool sequentialSafe = false, parallelSafe = false;
+            bank.setParallelSafety(1, 0);
+            sequentialTime += measureTime([&]() { sequentialSafe = bank.findSafeSequence(sequentialSequence); });
+            bank.setParallelSafety(threads, 0);
+            parallelTime += measureTime([&]() { parallelSafe = bank.findSafeSequence(parallelSequence); });
+            if (sequentialSafe != parallelSafe || (parallelSafe && !bank.replaysSafely(parallelSequence))) {
+                mismatches++;
+            }
+            safeCount += parallelSafe;
+        }
+        if (crossover == 0 && parallelTime < sequentialTime) crossover = n;
+        std::cout << std::setw(10) << n << std::fixed << std::setprecision(1)
+                  << std::setw(22) << sequentialTime / trials << std::setw(18) << parallelTime / trials
+                  << std::setw(11) << sequentialTime / std::max(parallelTime, 1e-9) << "x"
+                  << std::setw(8) << safeCount << "/" << trials << "\n";
+    }
+
+    std::cout << "\nТочка выигрыша: "
+              << (crossover ? "от " + std::to_string(crossover) + " процессов" : "не найдена")
+              << " (аппаратных потоков: " << std::thread::hardware_concurrency() << ")\n";
+    std::cout << (mismatches == 0 ? "✓ Вердикты совпадают на всех состояниях\n"
+                                  : "✗ Расхождений: " + std::to_string(mismatches) + "\n");
+    return mismatches == 0 ? 0 : 1;
+}
+
+double percentile(std::vector<double> values, double share) {
+    if (values.empty()) return 0.0;
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(share * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+// Latency of one-unit grants with and without the remembered safe sequence.
+// Both banks replay the same stream of requests and releases, and every
+// decision is compared between them.
+int runGrantBenchmark(int processes, int resources, int operations, ConfigShape shape) {
+    BankConfig config = makeRandomConfig(processes, resources, 7, shape);
+    BankersAlgorithm incremental = makeBank(config);
+    BankersAlgorithm full = makeBank(config);
+    incremental.setLogger(nullptr);
+    full.setLogger(nullptr);
+    full.setIncrementalSafety(false);
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<> pickProcess(0, processes - 1);
+    std::uniform_int_distribution<> pickResource(0, resources - 1);
+    std::vector<double> incrementalUs, fullUs;
+    int granted = 0, unsafe = 0, mismatches = 0, released = 0;
+
+    for (int op = 0; op < operations; ++op) {
+        int pid = pickProcess(gen);
+        if (op % 100 == 99) {
+            incremental.releaseResources(pid);
+            full.releaseResources(pid);
+            released++;
+            continue;
+        }
+        std::vector<int> request(resources, 0);
+        request[pickResource(gen)] = 1;
+
+        GrantResult a = GrantResult::Granted, b = GrantResult::Granted;
+        double timeA = measureTime([&]() { a = incremental.tryRequestResources(pid, request); });
+        double timeB = measureTime([&]() { b = full.tryRequestResources(pid, request); });
+        if (a != b) mismatches++;
+        // Only attempts that reached the safety check are timed
+        if (a == GrantResult::Granted || a == GrantResult::Unsafe) {
+            incrementalUs.push_back(timeA);
+            fullUs.push_back(timeB);
+            granted += a == GrantResult::Granted;
+            unsafe += a == GrantResult::Unsafe;
+        }
+    }
+
+    SafetyStats stats = incremental.getSafetyStats();
+    std::cout << "\nЗадержка выделения ресурсов (процессов: " << processes << ", ресурсов: " << resources
+              << ", операций: " << operations
+              << (shape == ConfigShape::Chained ? ", цепочка потребностей" : "") << ")\n";
+    std::cout << "   Выделено: " << granted << ", отклонено как небезопасные: " << unsafe
+              << ", завершено процессов: " << released << "\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "   Полная проверка:        p50 " << percentile(fullUs, 0.5) << " мкс, p99 "
+              << percentile(fullUs, 0.99) << " мкс\n";
+    std::cout << "   Инкрементальная:        p50 " << percentile(incrementalUs, 0.5) << " мкс, p99 "
+              << percentile(incrementalUs, 0.99) << " мкс\n";
+    std::cout << "   Проверок по сохранённой последовательности: " << stats.incrementalChecks
+              << ", полных: " << stats.fullChecks << "\n";
+    std::cout << (mismatches == 0 ? "✓ Решения совпадают\n"
+                                  : "✗ Расхождений: " + std::to_string(mismatches) + "\n");
+    return mismatches == 0 ? 0 : 1;
+}
+
+// Grants per second from several threads hammering one bank with
+// one-unit requests and occasional releases, with full checks made under
+// bankMutex and then optimistically outside it
+int runConcurrentBenchmark(int processes, int resources, int threads, int opsPerThread, bool incremental) {
+    std::cout << "\nКонкурентные запросы (процессов: " << processes << ", ресурсов: " << resources
+              << ", потоков: " << threads << ", операций на поток: " << opsPerThread
+              << (incremental ? "" : ", без инкрементальной проверки") << ")\n";
+    BankConfig config = makeRandomConfig(processes, resources, 11, ConfigShape::Random);
+    bool allValid = true;
+
+    for (bool optimistic : {false, true}) {
+        BankersAlgorithm bank = makeBank(config);
+        bank.setLogger(nullptr);
+        bank.setIncrementalSafety(incremental);
+        bank.setOptimisticSafety(optimistic);
+        std::atomic<long long> granted{0}, unsafe{0};
+
+        double elapsedUs = measureTime([&]() {
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t]() {
+                    std::mt19937 gen(100 + t);
+                    std::uniform_int_distribution<> pickResource(0, resources - 1);
+                    // Each thread drives its own slice of the processes
+                    int slice = std::max(1, (processes - t + threads - 1) / threads);
+                    std::uniform_int_distribution<> pickSlot(0, slice - 1);
+                    std::vector<int> request(resources, 0);
+                    for (int op = 0; op < opsPerThread; ++op) {
+                        int pid = std::min(processes - 1, t + threads * pickSlot(gen));
+                        if (op % 100 == 99) {
+                            bank.releaseResources(pid);
+                            continue;
+                        }
+                        int j = pickResource(gen);
+                        request[j] = 1;
+                        GrantResult result = bank.tryRequestResources(pid, request);
+                        request[j] = 0;
+                        if (result == GrantResult::Granted) granted++;
+                        if (result == GrantResult::Unsafe) unsafe++;
+                    }
+                });
+            }
+            for (auto& w : workers) w.join();
+        });
+
+        SafetyStats stats = bank.getSafetyStats();
+        bool valid = bank.checkInvariants();
+        allValid = allValid && valid;
+        std::cout << (optimistic ? "   Оптимистичная проверка: " : "   Проверка под блокировкой: ")
+                  << std::fixed << std::setprecision(0) << granted * 1e6 / elapsedUs << " выделений/с, "
+                  << "небезопасных: " << unsafe << ", полных проверок: " << stats.fullChecks
+                  << ", вне блокировки: " << stats.optimisticChecks
+                  << ", конфликтов: " << stats.optimisticConflicts
+                  << (valid ? ", инварианты ✓" : ", инварианты ✗") << "\n";
+    }
+    return allValid ? 0 : 1;
+}
+
+// Request/release throughput with full logging, formatted and written under
+// the bank's lock (the old console output) vs pushed to the async logger
+int runLoggingBenchmark(int threads, int opsPerThread, const std::string& path) {
+    const int processes = 512, resources = 8;
+    std::cout << "\nЖурналирование (потоков: " << threads << ", операций на поток: " << opsPerThread
+              << ", журнал: " << path << ")\n";
+    BankConfig config = makeRandomConfig(processes, resources, 5, ConfigShape::Random);
+
+    for (bool synchronous : {true, false}) {
+        std::ofstream sink(path);
+        if (!sink) {
+            throw std::runtime_error("Не удалось открыть файл журнала: " + path);
+        }
+        double elapsedUs = 0;
+        uint64_t written = 0, dropped = 0;
+        {
+            AsyncLogger logger(sink, LogLevel::All, synchronous);
+            BankersAlgorithm bank = makeBank(config);
+            bank.setLogger(&logger);
+
+            elapsedUs = measureTime([&]() {
+                std::vector<std::thread> workers;
+                for (int t = 0; t < threads; ++t) {
+                    workers.emplace_back([&, t]() {
+                        std::mt19937 gen(200 + t);
+                        std::uniform_int_distribution<> pickResource(0, resources - 1);
+                        std::uniform_int_distribution<> pickSlot(0, processes / threads - 1);
+                        std::vector<int> request(resources, 0);
+                        for (int op = 0; op < opsPerThread; ++op) {
+                            int pid = t + threads * pickSlot(gen);
+                            if (op % 50 == 49) {
+                                bank.releaseResources(pid);
+                                continue;
+                            }
+                            int j = pickResource(gen);
+                            request[j] = 1;
+                            bank.requestResources(pid, request, 1, 0);
+                            request[j] = 0;
+                        }
+                    });
+                }
+                for (auto& w : workers) w.join();
+            });
+            logger.flush();
+            written = logger.writtenCount();
+            dropped = logger.droppedCount();
+        }
+        std::cout << (synchronous ? "   Синхронный вывод:   " : "   Асинхронный журнал: ")
+                  << std::fixed << std::setprecision(0) << threads * opsPerThread * 1e6 / elapsedUs
+                  << " операций/с, записано событий: " << written << ", потеряно: " << dropped << "\n";
+    }
+    return 0;
+}
+
+// Many requesters blocked on an empty pool while holders release one by
+// one. Each holder adds room for two more waiters, each of which holds its
+// units briefly, so every release can help only a couple of the blocked
+// threads; broadcasting to all of them wakes O(waiters²) threads in vain.
+int runWakeupBenchmark(int waiters) {
+    const int holders = std::max(1, waiters / 2), resources = 4;
+    std::cout << "\nПробуждение ожидающих (ожидающих потоков: " << waiters
+              << ", освобождающих процессов: " << holders << ")\n";
+
+    // Holders P0..P(h-1) keep two units of everything and need nothing more;
+    // waiters need one unit of everything and start with nothing
+    BankConfig config;
+    config.processes = holders + waiters;
+    config.resources = resources;
+    config.available.assign(resources, 0);
+    config.maximum.assign(config.processes, std::vector<int>(resources, 1));
+    config.allocation.assign(config.processes, std::vector<int>(resources, 0));
+    for (int i = 0; i < holders; ++i) {
+        config.maximum[i].assign(resources, 2);
+        config.allocation[i].assign(resources, 2);
+    }
+
+    bool allValid = true;
+    for (bool targeted : {false, true}) {
+        BankersAlgorithm bank = makeBank(config);
+        bank.setLogger(nullptr);
+        bank.setTargetedWakeups(targeted);
+        std::atomic<int> granted{0};
+
+        double elapsedUs = measureTime([&]() {
+            std::vector<std::thread> threads;
+            for (int w = 0; w < waiters; ++w) {
+                threads.emplace_back([&, w]() {
+                    int pid = holders + w;
+                    if (bank.requestResources(pid, std::vector<int>(resources, 1), 1000, 1000)) {
+                        granted++;
+                        std::this_thread::sleep_for(std::chrono::microseconds(500));
+                    }
+                    bank.releaseResources(pid);
+                });
+            }
+            // Let the waiters block before the first release
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            for (int i = 0; i < holders; ++i) {
+                bank.releaseResources(i);
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            for (auto& t : threads) t.join();
+        });
+
+        WaitStats stats = bank.getWaitStats();
+        bool valid = bank.checkInvariants() && granted == waiters;
+        allValid = allValid && valid;
+        std::cout << (targeted ? "   Адресное пробуждение: " : "   Пробуждение всех:     ")
+                  << std::fixed << std::setprecision(1) << elapsedUs / 1000 << " мс, выделено: " << granted
+                  << ", ожиданий: " << stats.waits << ", пробуждений: " << stats.wakeups
+                  << ", напрасных: " << stats.futileWakeups << ", таймаутов: " << stats.timeouts
+                  << (valid ? ", инварианты ✓" : ", инварианты ✗") << "\n";
+    }
+    return allValid ? 0 : 1;
+}
+
+// Bursts of requests decided one by one vs as batches. FIFO batches must
+// reproduce the one-by-one decisions exactly; the other policies only
+// change which requests win.
+int runBatchBenchmark(int processes, int resources, int batchSize, int batches) {
+    std::cout << "\nПакетное выделение (процессов: " << processes << ", ресурсов: " << resources
+              << ", размер пакета: " << batchSize << ", пакетов: " << batches << ")\n";
+    BankConfig config = makeRandomConfig(processes, resources, 21, ConfigShape::Chained);
+
+    std::mt19937 gen(9);
+    std::uniform_int_distribution<> pickProcess(0, processes - 1);
+    std::uniform_int_distribution<> pickResource(0, resources - 1);
+    std::uniform_int_distribution<> pickUnits(1, 3);
+    std::vector<std::vector<PendingRequest>> bursts(batches);
+    for (auto& burst : bursts) {
+        for (int k = 0; k < batchSize; ++k) {
+            PendingRequest pending{pickProcess(gen), std::vector<int>(resources, 0), pickUnits(gen)};
+            pending.request[pickResource(gen)] = pickUnits(gen);
+            burst.push_back(pending);
+        }
+    }
+    // Each burst is followed by a few releases so the pool keeps moving
+    std::vector<std::vector<int>> releases(batches);
+    for (auto& list : releases) {
+        for (int k = 0; k < std::max(1, batchSize / 16); ++k) list.push_back(pickProcess(gen));
+    }
+
+    bool sameDecisions = true;
+    std::vector<GrantResult> reference;
+    for (bool incremental : {false, true}) {
+        struct Mode { const char* name; bool batched; AdmissionPolicy policy; };
+        for (Mode mode : {Mode{"по одному", false, AdmissionPolicy::Fifo},
+                          Mode{"пакет FIFO", true, AdmissionPolicy::Fifo},
+                          Mode{"пакет, сначала меньшие", true, AdmissionPolicy::SmallestFirst},
+                          Mode{"пакет по приоритету", true, AdmissionPolicy::Priority}}) {
+            BankersAlgorithm bank = makeBank(config);
+            bank.setLogger(nullptr);
+            bank.setIncrementalSafety(incremental);
+            std::vector<GrantResult> decisions;
+            double elapsedUs = measureTime([&]() {
+                for (int b = 0; b < batches; ++b) {
+                    if (mode.batched) {
+                        std::vector<GrantResult> results = bank.grantBatch(bursts[b], mode.policy);
+                        decisions.insert(decisions.end(), results.begin(), results.end());
+                    } else {
+                        for (const PendingRequest& pending : bursts[b]) {
+                            decisions.push_back(bank.tryRequestResources(pending.processId, pending.request));
+                        }
+                    }
+                    for (int pid : releases[b]) bank.releaseResources(pid);
+                }
+            });
+
+            if (!mode.batched) reference = decisions;
+            if (mode.batched && mode.policy == AdmissionPolicy::Fifo && decisions != reference) {
+                sameDecisions = false;
+            }
+            long long grants = std::count(decisions.begin(), decisions.end(), GrantResult::Granted);
+            SafetyStats stats = bank.getSafetyStats();
+            std::cout << "   " << (incremental ? "[инкр.] " : "[полн.] ") << mode.name << ": "
+                      << std::fixed << std::setprecision(0) << grants * 1e6 / elapsedUs << " выделений/с, выделено: "
+                      << grants << ", полных проверок: " << stats.fullChecks
+                      << (bank.checkInvariants() ? ", инварианты ✓" : ", инварианты ✗") << "\n";
+        }
+    }
+    std::cout << (sameDecisions ? "✓ Пакеты FIFO совпадают с решениями по одному\n"
+                                : "✗ Пакеты FIFO расходятся с решениями по одному\n");
+    return sameDecisions ? 0 : 1;
+}
+
+// Long-running service: every round one process leaves and a new one
+// arrives with a random claim, followed by a few one-unit requests; now and
+// then a resource type gets more capacity. The number of slots must stay at
+// the live count, and so must the cost of a full safety check.
+int runChurnBenchmark(int processes, int resources, int rounds) {
+    std::cout << "\nСмена процессов (живых: " << processes << ", ресурсов: " << resources
+              << ", раундов: " << rounds << ")\n";
+    BankConfig config = makeRandomConfig(processes, resources, 53, ConfigShape::Random);
+    BankersAlgorithm bank = makeBank(config);
+    bank.setLogger(nullptr);
+
+    std::mt19937 gen(54);
+    std::uniform_int_distribution<> units(0, 10);
+    std::uniform_int_distribution<> pickResource(0, resources - 1);
+    std::vector<int> live(processes);
+    for (int i = 0; i < processes; ++i) live[i] = i;
+    std::uniform_int_distribution<size_t> pickLive(0, live.size() - 1);
+
+    const int reportEvery = std::max(1, rounds / 5);
+    std::cout << "    раунд   слотов   живых   проверка, мкс   выдано\n";
+    long long granted = 0;
+    std::vector<int> claim(resources), amounts(resources);
+    for (int round = 1; round <= rounds; ++round) {
+        size_t leaving = pickLive(gen);
+        bank.unregisterProcess(live[leaving]);
+        for (int& c : claim) c = units(gen);
+        live[leaving] = bank.registerProcess(claim);
+
+        for (int k = 0; k < 4; ++k) {
+            std::fill(amounts.begin(), amounts.end(), 0);
+            amounts[pickResource(gen)] = 1;
+            granted += bank.tryRequestResources(live[pickLive(gen)], amounts) == GrantResult::Granted;
+        }
+        if (round % 100 == 0) bank.addResourceCapacity(pickResource(gen), 1);
+
+        if (round % reportEvery == 0) {
+            std::vector<int> sequence;
+            double checkUs = measureTime([&]() { bank.findSafeSequence(sequence); });
+            std::cout << std::setw(9) << round << std::setw(9) << bank.getProcessSlots()
+                      << std::setw(8) << bank.getActiveProcessCount()
+                      << std::fixed << std::setprecision(1) << std::setw(16) << checkUs
+                      << std::setw(9) << granted << "\n";
+        }
+    }
+
+    bool bounded = bank.getProcessSlots() == processes;
+    bool consistent = bank.checkInvariants();
+    std::cout << (bounded ? "✓ Слоты переиспользуются, таблица не растёт\n"
+                          : "✗ Таблица процессов выросла\n");
+    std::cout << (consistent ? "✓ Инварианты банка соблюдены\n" : "✗ Нарушены инварианты банка\n");
+    return bounded && consistent ? 0 : 1;
+}
+
+// Coroutine that starts right away and frees its frame when it finishes
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+struct AsyncRunStats {
+    std::atomic<long long> granted{0};
+    std::atomic<long long> rejected{0};
+    std::atomic<int> running{0};
+    std::promise<void> allDone;
+};
+
+// One simulated process: takes its claim one unit at a time, sometimes
+// hands a unit back, then finishes. Suspends instead of blocking whenever
+// the bank parks its request
+DetachedTask simulateAsyncProcess(BankersAlgorithm& bank, int processId, std::vector<int> need,
+                                  int steps, unsigned seed, AsyncRunStats& stats) {
+    std::mt19937 gen(seed);
+    std::vector<int> amounts(need.size(), 0);
+    for (int step = 0; step < steps; ++step) {
+        std::vector<int> open;
+        for (size_t j = 0; j < need.size(); ++j) {
+            if (need[j] > 0) open.push_back(static_cast<int>(j));
+        }
+        if (open.empty()) break;
+        int j = open[gen() % open.size()];
+        std::fill(amounts.begin(), amounts.end(), 0);
+        amounts[j] = 1;
+
+        GrantResult result = co_await bank.requestResourcesAwaitable(processId, amounts);
+        if (result != GrantResult::Granted) {
+            stats.rejected++;
+            break;
+        }
+        stats.granted++;
+        need[j]--;
+        if (gen() % 4 == 0 && bank.releaseResources(processId, amounts)) need[j]++;
+    }
+    bank.releaseResources(processId);
+    if (stats.running.fetch_sub(1) == 1) stats.allDone.set_value();
+}
+
+// Small random banks: park a request, then finish the other processes one
+// by one. After each release a twin bank with the same history is asked
+// directly; if it grants the request, the parked one must have completed.
+// Returns the number of requests left parked although granting was safe
+int countStuckParkedRequests(unsigned seeds) {
+    int stuck = 0;
+    for (unsigned seed = 0; seed < seeds; ++seed) {
+        BankConfig config = makeRandomConfig(4, 2, seed, ConfigShape::Random, 0.0, 4);
+        BankersAlgorithm bank = makeBank(config);
+        BankersAlgorithm twin = makeBank(config);
+        bank.setLogger(nullptr);
+        twin.setLogger(nullptr);
+
+        std::mt19937 gen(seed);
+        int pid = static_cast<int>(gen() % config.processes);
+        std::vector<int> request(config.resources);
+        for (int j = 0; j < config.resources; ++j) {
+            int need = config.maximum[pid][j] - config.allocation[pid][j];
+            request[j] = static_cast<int>(gen() % (need + 1));
+        }
+        std::future<GrantResult> parked = bank.requestResourcesAsync(pid, request);
+        if (parked.wait_for(std::chrono::seconds(0)) == std::future_status::ready) continue;
+
+        for (int other = 0; other < config.processes; ++other) {
+            if (other == pid) continue;
+            bank.releaseResources(other);
+            twin.releaseResources(other);
+            if (parked.wait_for(std::chrono::seconds(0)) == std::future_status::ready) break;
+            if (twin.tryRequestResources(pid, request) == GrantResult::Granted) {
+                stuck++;
+                break;
+            }
+        }
+    }
+    return stuck;
+}
+
+// Thousands of processes as coroutines on a small thread pool: none of
+// them holds a thread while its request is parked
+int runAsyncBenchmark(int processes, int resources, int steps, int threads) {
+    std::cout << "\nАсинхронные запросы (процессов: " << processes << ", ресурсов: " << resources
+              << ", шагов на процесс: " << steps << ", потоков исполнителя: " << threads << ")\n";
+    BankConfig config = makeRandomConfig(processes, resources, 91, ConfigShape::Random);
+    BankersAlgorithm bank = makeBank(config);
+    bank.setLogger(nullptr);
+
+    AsyncRunStats stats;
+    stats.running = processes;
+    std::future<void> done = stats.allDone.get_future();
+    double elapsedUs;
+    {
+        ThreadPool pool(threads);
+        bank.setExecutor([&pool](std::function<void()> task) { pool.post(std::move(task)); });
+        elapsedUs = measureTime([&]() {
+            for (int pid = 0; pid < processes; ++pid) {
+                std::vector<int> need(resources);
+                for (int j = 0; j < resources; ++j) need[j] = config.maximum[pid][j] - config.allocation[pid][j];
+                pool.post([&bank, &stats, pid, need, steps]() {
+                    simulateAsyncProcess(bank, pid, need, steps, 900u + pid, stats);
+                });
+            }
+            done.wait();
+        });
+    }
+
+    WaitStats waits = bank.getWaitStats();
+    bool allFinished = bank.getActiveProcessCount() == 0;
+    bool invariants = bank.checkInvariants();
+    int stuck = countStuckParkedRequests(300);
+    std::cout << std::fixed << std::setprecision(0)
+              << "   Выделено: " << stats.granted.load() << ", отклонено: " << stats.rejected.load()
+              << ", выделений/с: " << stats.granted.load() * 1e6 / elapsedUs << "\n"
+              << "   Отложено запросов: " << waits.parked << ", возобновлено освобождениями: " << waits.resumed << "\n"
+              << std::setprecision(1) << "   Время: " << elapsedUs / 1000 << " мс\n"
+              << (allFinished ? "✓ Все процессы завершились\n" : "✗ Остались незавершённые процессы\n")
+              << (invariants ? "✓ Инварианты банка соблюдены\n" : "✗ Нарушены инварианты банка\n")
+              << (stuck == 0 ? "✓ Отложенные запросы выполняются, как только это безопасно\n"
+                             : "✗ Безопасных запросов осталось отложенными: " + std::to_string(stuck) + "\n");
+    return allFinished && invariants && stuck == 0 ? 0 : 1;
+}
+
+// Sustained load without sleeps: every thread owns a slice of the
+// processes, mirrors their allocations and fires one-unit-ish requests and
+// partial releases at full speed. Reports grants/sec, rejections by cause
+// and request latency percentiles, then checks the bank's invariants and
+// that its allocations match what the threads believe they hold.
+int runThroughputBenchmark(int processes, int resources, int threads, int opsPerThread) {
+    std::cout << "\nНагрузочный тест (процессов: " << processes << ", ресурсов: " << resources
+              << ", потоков: " << threads << ", операций на поток: " << opsPerThread << ")\n";
+    BankConfig config = makeRandomConfig(processes, resources, 31, ConfigShape::Random);
+    BankersAlgorithm bank = makeBank(config);
+    bank.setLogger(nullptr);
+
+    struct ThreadResult {
+        std::vector<double> latencyUs;
+        long long granted = 0, unsafe = 0, unavailable = 0, releases = 0;
+        bool mirrorMatches = true;
+    };
+    std::vector<ThreadResult> results(threads);
+
+    double elapsedUs = measureTime([&]() {
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                ThreadResult& result = results[t];
+                result.latencyUs.reserve(opsPerThread);
+                std::mt19937 gen(300 + t);
+                std::uniform_int_distribution<> pickResource(0, resources - 1);
+                std::uniform_int_distribution<> percent(0, 99);
+
+                std::vector<int> owned;
+                for (int pid = t; pid < processes; pid += threads) owned.push_back(pid);
+                if (owned.empty()) return;
+                std::uniform_int_distribution<size_t> pickOwned(0, owned.size() - 1);
+                // Allocation mirror for the owned processes, indexed like owned
+                std::vector<std::vector<int>> held;
+                for (int pid : owned) held.push_back(config.allocation[pid]);
+
+                std::vector<int> amounts(resources, 0);
+                for (int op = 0; op < opsPerThread; ++op) {
+                    size_t slot = pickOwned(gen);
+                    int pid = owned[slot];
+                    std::fill(amounts.begin(), amounts.end(), 0);
+                    int j = pickResource(gen);
+
+                    if (percent(gen) < 40) {
+                        // Give back up to half of what is held of resource j
+                        amounts[j] = (held[slot][j] + 1) / 2;
+                        if (amounts[j] == 0) continue;
+                        if (bank.releaseResources(pid, amounts)) {
+                            held[slot][j] -= amounts[j];
+                            result.releases++;
+                        }
+                        continue;
+                    }
+
+                    int room = config.maximum[pid][j] - held[slot][j];
+                    if (room == 0) continue;
+                    amounts[j] = std::min(room, 1 + percent(gen) % 2);
+                    GrantResult outcome = GrantResult::Granted;
+                    result.latencyUs.push_back(measureTime([&]() {
+                        outcome = bank.tryRequestResources(pid, amounts);
+                    }));
+                    if (outcome == GrantResult::Granted) {
+                        held[slot][j] += amounts[j];
+                        result.granted++;
+                    } else if (outcome == GrantResult::Unsafe) {
+                        result.unsafe++;
+                    } else if (outcome == GrantResult::Unavailable) {
+                        result.unavailable++;
+                    }
+                }
+
+                for (size_t slot = 0; slot < owned.size(); ++slot) {
+                    if (bank.allocationOf(owned[slot]) != held[slot]) result.mirrorMatches = false;
+                }
+            });
+        }
+        for (auto& w : workers) w.join();
+    });
+
+    ThreadResult total;
+    for (ThreadResult& result : results) {
+        total.latencyUs.insert(total.latencyUs.end(), result.latencyUs.begin(), result.latencyUs.end());
+        total.granted += result.granted;
+        total.unsafe += result.unsafe;
+        total.unavailable += result.unavailable;
+        total.releases += result.releases;
+        total.mirrorMatches = total.mirrorMatches && result.mirrorMatches;
+    }
+    bool invariants = bank.checkInvariants();
+    SafetyStats safety = bank.getSafetyStats();
+
+    std::cout << std::fixed << std::setprecision(0)
+              << "   Выделений/с: " << total.granted * 1e6 / elapsedUs
+              << ", запросов/с: " << total.latencyUs.size() * 1e6 / elapsedUs << "\n"
+              << "   Выделено: " << total.granted << ", небезопасных: " << total.unsafe
+              << ", нехватка ресурсов: " << total.unavailable << ", освобождений: " << total.releases << "\n"
+              << std::setprecision(2)
+              << "   Задержка запроса, мкс: p50 " << percentile(total.latencyUs, 0.5)
+              << ", p90 " << percentile(total.latencyUs, 0.9)
+              << ", p99 " << percentile(total.latencyUs, 0.99)
+              << ", p99.9 " << percentile(total.latencyUs, 0.999)
+              << ", макс " << percentile(total.latencyUs, 1.0) << "\n"
+              << "   Проверок по сохранённой последовательности: " << safety.incrementalChecks
+              << ", полных: " << safety.fullChecks << "\n"
+              << (invariants ? "✓ Allocation + Available == Total, состояние безопасно\n"
+                             : "✗ Нарушены инварианты банка\n")
+              << (total.mirrorMatches ? "✓ Выделения совпадают с учётом потоков\n"
+                                      : "✗ Выделения расходятся с учётом потоков\n");
+    if constexpr (METRICS_ENABLED) {
+        std::cout << "\nМетрики банка:\n" << bank.getMetrics().toJson() << "\n";
+    }
+    return invariants && total.mirrorMatches ? 0 : 1;
+}
+
+// Threads hammer one group each with one-unit requests and releases of
+// what they hold; returns grants per second. Works for BankersAlgorithm and
+// ShardedBanker alike, and checks the bank's allocations against what the
+// threads believe they hold.
+template<typename Bank>
+double runGroupLoad(Bank& bank, const BankConfig& config, int groups, int threads,
+                    int opsPerThread, bool& consistent) {
+    const int perGroup = config.processes / groups;
+    const int resourcesPerGroup = config.resources / groups;
+    std::vector<long long> granted(threads, 0);
+    std::vector<char> matches(threads, 1);
+
+    double elapsedUs = measureTime([&]() {
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                std::mt19937 gen(500 + t);
+                std::uniform_int_distribution<> percent(0, 99);
+                std::uniform_int_distribution<> pickResource(0, resourcesPerGroup - 1);
+                // Threads sharing a group split its processes
+                const int group = t % groups;
+                const int sharing = threads / groups + (group < threads % groups ? 1 : 0);
+                std::vector<int> owned;
+                for (int i = t / groups; i < perGroup; i += sharing) owned.push_back(group * perGroup + i);
+                if (owned.empty()) return;
+                std::uniform_int_distribution<size_t> pickOwned(0, owned.size() - 1);
+                std::vector<std::vector<int>> held;
+                for (int pid : owned) held.push_back(config.allocation[pid]);
+
+                std::vector<int> amounts(config.resources, 0);
+                for (int op = 0; op < opsPerThread; ++op) {
+                    size_t slot = pickOwned(gen);
+                    int pid = owned[slot];
+                    int j = group * resourcesPerGroup + pickResource(gen);
+                    std::fill(amounts.begin(), amounts.end(), 0);
+                    if (percent(gen) < 40) {
+                        amounts[j] = (held[slot][j] + 1) / 2;
+                        if (amounts[j] > 0 && bank.releaseResources(pid, amounts)) held[slot][j] -= amounts[j];
+                        continue;
+                    }
+                    if (config.maximum[pid][j] == held[slot][j]) continue;
+                    amounts[j] = 1;
+                    if (bank.tryRequestResources(pid, amounts) == GrantResult::Granted) {
+                        held[slot][j]++;
+                        granted[t]++;
+                    }
+                }
+                for (size_t slot = 0; slot < owned.size(); ++slot) {
+                    if (bank.allocationOf(owned[slot]) != held[slot]) matches[t] = 0;
+                }
+            });
+        }
+        for (auto& w : workers) w.join();
+    });
+
+    consistent = bank.checkInvariants() &&
+                 std::all_of(matches.begin(), matches.end(), [](char m) { return m != 0; });
+    long long sum = 0;
+    for (long long g : granted) sum += g;
+    return sum * 1e6 / elapsedUs;
+}
+
+// One lock for everything vs one lock per independent group, on the same
+// block-diagonal state and the same load
+int runShardedBenchmark(int groups, int processesPerGroup, int resourcesPerGroup, int opsPerThread) {
+    BankConfig config = makeShardedConfig(groups, processesPerGroup, resourcesPerGroup, 71);
+    std::cout << "\nШардирование по независимым группам ресурсов (групп: " << groups
+              << ", процессов в группе: " << processesPerGroup << ", ресурсов в группе: "
+              << resourcesPerGroup << ", аппаратных потоков: " << std::thread::hardware_concurrency() << ")\n";
+    std::cout << "  потоков   один замок, выд/с   шарды, выд/с   ускорение\n";
+
+    bool allConsistent = true;
+    for (int threads = 1; threads <= 2 * groups; threads *= 2) {
+        BankersAlgorithm single = makeBank(config);
+        single.setLogger(nullptr);
+        ShardedBanker sharded(config.processes, config.resources, config.available,
+                              config.maximum, config.allocation);
+        if (sharded.getShardCount() != groups) allConsistent = false;
+
+        bool singleOk = false, shardedOk = false;
+        double singleRate = runGroupLoad(single, config, groups, threads, opsPerThread, singleOk);
+        double shardedRate = runGroupLoad(sharded, config, groups, threads, opsPerThread, shardedOk);
+        allConsistent = allConsistent && singleOk && shardedOk;
+        std::cout << std::setw(9) << threads << std::fixed << std::setprecision(0)
+                  << std::setw(20) << singleRate << std::setw(15) << shardedRate
+                  << std::setprecision(2) << std::setw(11) << shardedRate / std::max(singleRate, 1e-9) << "x\n";
+    }
+
+    std::cout << (allConsistent ? "✓ Шарды найдены верно, инварианты и выделения сходятся\n"
+                                : "✗ Ошибка шардирования или расхождение выделений\n");
+    return allConsistent ? 0 : 1;
+}
+
+// ==================== Command-line Modes ====================
+
+void printUsage(const char* program) {
+    std::cout << "\nИспользование:\n"
+              << "  " << program << "                      демонстрация\n"
+              << "  " << program << " --bench-safety [макс_процессов] [ресурсов] [состояний]\n"
+              << "  " << program << " --bench-parallel-safety [макс_процессов] [ресурсов] [потоков]\n"
+              << "  " << program << " --bench-grant [процессов] [ресурсов] [операций] [chained]\n"
+              << "  " << program << " --bench-concurrent [процессов] [ресурсов] [потоков] [операций_на_поток] [full]\n"
+              << "  " << program << " --bench-logging [потоков] [операций_на_поток] [файл_журнала]\n"
+              << "  " << program << " --bench-wakeups [ожидающих_потоков]\n"
+              << "  " << program << " --bench-batch [процессов] [ресурсов] [размер_пакета] [пакетов]\n"
+              << "  " << program << " --bench-sharded [групп] [процессов_в_группе] [ресурсов_в_группе] [операций_на_поток]\n"
+              << "  " << program << " --bench-async [процессов] [ресурсов] [шагов] [потоков_исполнителя]\n"
+              << "  " << program << " --bench-churn [процессов] [ресурсов] [раундов]\n"
+              << "  " << program << " --bench-throughput [процессов] [ресурсов] [потоков] [операций_на_поток]\n"
+              << "  (при сборке с -DBANKER_ENABLE_METRICS --bench-throughput печатает метрики банка в JSON)\n";
+}
+
+int runCommand(int argc, char* argv[]) {
+    std::string command = argv[1];
+    auto intArg = [&](int index, int fallback) { return argc > index ? std::max(1, std::stoi(argv[index])) : fallback; };
+
+    try {
+        if (command == "--bench-safety") {
+            return runSafetyBenchmark(intArg(2, 4000), intArg(3, 16), intArg(4, 5));
+        }
+        if (command == "--bench-parallel-safety") {
+            return runParallelSafetyBenchmark(intArg(2, 64000), intArg(3, 64), intArg(4, 4));
+        }
+        if (command == "--bench-concurrent") {
+            bool fullOnly = argc > 6 && std::string(argv[6]) == "full";
+            return runConcurrentBenchmark(intArg(2, 2000), intArg(3, 16), intArg(4, 4), intArg(5, 2000), !fullOnly);
+        }
+        if (command == "--bench-logging") {
+            return runLoggingBenchmark(intArg(2, 4), intArg(3, 20000), argc > 4 ? argv[4] : "/dev/null");
+        }
+        if (command == "--bench-wakeups") {
+            return runWakeupBenchmark(intArg(2, 64));
+        }
+        if (command == "--bench-batch") {
+            return runBatchBenchmark(intArg(2, 1000), intArg(3, 16), intArg(4, 64), intArg(5, 50));
+        }
+        if (command == "--bench-sharded") {
+            return runShardedBenchmark(intArg(2, 8), intArg(3, 250), intArg(4, 8), intArg(5, 20000));
+        }
+        if (command == "--bench-async") {
+            return runAsyncBenchmark(intArg(2, 2000), intArg(3, 8), intArg(4, 20), intArg(5, 2));
+        }
+        if (command == "--bench-churn") {
+            return runChurnBenchmark(intArg(2, 2000), intArg(3, 16), intArg(4, 20000));
+        }
+        if (command == "--bench-throughput") {
+            return runThroughputBenchmark(intArg(2, 4000), intArg(3, 128), intArg(4, 4), intArg(5, 10000));
+        }
+        if (command == "--bench-grant") {
+            bool chained = argc > 5 && std::string(argv[5]) == "chained";
+            return runGrantBenchmark(intArg(2, 2000), intArg(3, 16), intArg(4, 5000),
+                                     chained ? ConfigShape::Chained : ConfigShape::Random);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Ошибка: " << e.what() << "\n";
+        return 1;
+    }
+
+    printUsage(argv[0]);
+    return 1;
+}
+
 // ==================== Main ====================
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc >= 2 && std::strncmp(argv[1], "--", 2) == 0) {
+        return runCommand(argc, argv);
+    }
+
     std::cout << "╔══════════════════════════════════════════════════════════════════╗\n";
     std::cout << "║     Лабораторная работа №4 - Задание 3, Вариант 1              ║\n";
     std::cout << "║     Алгоритм банкира (Banker's Algorithm) - УЛУЧШЕННАЯ ВЕРСИЯ  ║\n";
@@ -506,13 +3612,16 @@ int main() {
 
         std::cout << "\nТест 1: P1 запрашивает [1, 0, 2]";
         bank1.requestResources(1, {1, 0, 2});
+        bank1.flushLog();
 
         BankersAlgorithm bank2(numProcesses, numResources, available, maximum, allocation);
         std::cout << "\nТест 2: P4 запрашивает [3, 3, 0]";
         bank2.requestResources(4, {3, 3, 0});
+        bank2.flushLog();
 
         std::cout << "\nТест 3: P0 запрашивает [0, 2, 0]";
         bank2.requestResources(0, {0, 2, 0});
+        bank2.flushLog();
 
     } catch (const std::exception& e) {
         std::cerr << "Ошибка инициализации: " << e.what() << "\n";
@@ -566,6 +3675,7 @@ int main() {
         for (auto& t : threads) {
             t.join();
         }
+        bank3.flushLog();
 
         std::cout << "\n" << std::string(60, '-') << "\n";
         std::cout << "Симуляция завершена.\n";